@@ -5,6 +5,8 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
@@ -128,4 +130,9 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+  if (malloc_memstats)
+    {
+      palloc_print_stats ();
+      malloc_print_stats ();
+    }
 }
@@ -17,8 +17,79 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
-/* Number of timer ticks since OS booted. */
+/* Number of timer ticks since OS booted.  Only advanced with
+   interrupts off, under ticks_seq, so that timer_ticks() can read
+   it without turning interrupts off. */
 static int64_t ticks;
+static struct seqlock ticks_seq;
+
+/* Timer wheel of pending callouts.
+
+   Level 0 has one slot per tick for the next WHEEL_SIZE ticks.
+   Each higher level has slots WHEEL_SIZE times as coarse as the
+   level below it.  A callout sits at the lowest level whose span
+   reaches its expiry tick, so adding one is O(1).  Whenever the
+   level-0 index wraps around, the due slot of the next level up
+   is "cascaded": its callouts are re-added, landing in finer
+   slots.  Each tick then runs only the callouts in one level-0
+   slot.  Callouts further away than the whole wheel spans wait
+   in the top level and are re-added each time it cascades. */
+#define WHEEL_BITS 6                    /* Log2 of slots per level. */
+#define WHEEL_SIZE (1 << WHEEL_BITS)    /* Slots per level. */
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4                  /* Number of levels. */
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+
+/* Next tick whose level-0 slot the wheel will run. */
+static int64_t wheel_ticks;
+
+/* Tickless idle.
+
+   While the idle thread halts, there is usually nothing for the
+   periodic interrupt to do.  If no callout is due within the
+   next few ticks, timer_idle_sleep() instead puts the PIT into
+   one-shot mode for the number of ticks until the next one (at
+   most TICKLESS_MAX_TICKS, since the PIT counter is only 16
+   bits wide), and the tick count is caught up when the one-shot
+   fires or when the idle thread is woken earlier by another
+   interrupt.  The one-shot is timed from the last tick counted,
+   not from when it is started, and the part of a tick left over
+   by an early wake-up is carried into the next one-shot, so that
+   the tick count does not drift.
+
+   Only the idle thread goes tickless.  A lone runnable thread,
+   which the scheduler could in principle leave running to the
+   end of its time slice with no periodic tick, keeps the tick:
+   thread_tick() does that thread's per-tick accounting (time
+   slice, CPU time statistics, the fair scheduler's vruntime),
+   and every path that makes a second thread ready, including
+   interrupt handlers, would have to restore the periodic tick
+   first.  A busy CPU does not halt either, so there is little to
+   save. */
+bool timer_tickless;
+
+/* PIT cycles per timer tick. */
+#define PIT_CYCLES_PER_TICK ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Most ticks one PIT one-shot can span. */
+#define TICKLESS_MAX_TICKS (65536 / PIT_CYCLES_PER_TICK)
+
+/* Ticks spanned by the pending one-shot, or 0 if the PIT is in
+   periodic mode. */
+static int oneshot_ticks;
+
+/* PIT count the pending one-shot was started with. */
+static unsigned oneshot_count;
+
+/* PIT cycles past the last tick counted in `ticks' when the
+   pending one-shot was started. */
+static unsigned oneshot_start;
+
+/* PIT cycles that had passed since the last tick counted when the
+   periodic interrupt was last restarted, not yet counted.  The
+   periodic interrupt runs this far behind the true tick
+   boundaries until the next one-shot makes up for it. */
+static unsigned tick_carry;
 
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
@@ -29,12 +100,25 @@ static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static void wheel_insert (struct timer_callout *);
+static void wheel_cascade (int level);
+static void wheel_run (void);
+static int ticks_until_due (void);
+static void advance_ticks (int64_t cnt);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
 timer_init (void) 
 {
+  int level, slot;
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SIZE; slot++)
+      list_init (&wheel[level][slot]);
+  wheel_ticks = 0;
+  seqlock_init (&ticks_seq);
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -70,9 +154,15 @@ timer_calibrate (void)
 int64_t
 timer_ticks (void) 
 {
-  enum intr_level old_level = intr_disable ();
-  int64_t t = ticks;
-  intr_set_level (old_level);
+  unsigned seq;
+  int64_t t;
+
+  do
+    {
+      seq = seqlock_read_begin (&ticks_seq);
+      t = ticks;
+    }
+  while (seqlock_read_retry (&ticks_seq, seq));
   return t;
 }
 
@@ -159,6 +249,127 @@ timer_ndelay (int64_t ns)
   real_time_delay (ns, 1000 * 1000 * 1000);
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  If tickless idle is enabled and no callout is due for
+   at least two ticks, stops the periodic timer interrupt and
+   programs a single one for when the next callout is due. */
+void
+timer_idle_sleep (void)
+{
+  int idle_ticks;
+  unsigned count;
+  bool output;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* The MLFQS scheduler updates its load average on the tick. */
+  if (!timer_tickless || thread_mlfqs || oneshot_ticks > 0)
+    return;
+
+  idle_ticks = ticks_until_due ();
+  if (idle_ticks < 2)
+    return;
+
+  /* Time the one-shot from the last tick counted: the periodic
+     counter tells how far into the current tick we are, and
+     tick_carry how far behind the periodic interrupt was
+     running.  This is under two ticks, so the count is at least
+     1.  If a periodic interrupt is already pending, the counter
+     has restarted from a tick boundary that timer_interrupt()
+     has yet to count, and will count as a periodic tick. */
+  count = pit_read_count (0, &output);
+  if (count == 0 || count > PIT_CYCLES_PER_TICK)
+    count = PIT_CYCLES_PER_TICK;
+  oneshot_start = tick_carry + (PIT_CYCLES_PER_TICK - count);
+  oneshot_count = idle_ticks * PIT_CYCLES_PER_TICK - oneshot_start;
+  oneshot_ticks = idle_ticks;
+  pit_start_oneshot (0, oneshot_count);
+}
+
+/* Called with interrupts off when the idle thread stops halting.
+   If a one-shot set by timer_idle_sleep() is still counting
+   down, accounts for the whole ticks that have passed and
+   restores the periodic interrupt.  If it has already run out,
+   the pending timer interrupt does this instead.
+
+   Callouts that came due are left for the next timer interrupt,
+   whose wheel_run() catches up on every tick passed.  Running
+   them here would be unsafe: the caller may be schedule(), where
+   no thread is running, and a callout that wakes a thread could
+   try to yield the idle thread. */
+void
+timer_idle_wake (void)
+{
+  unsigned remaining, elapsed;
+  bool expired;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (oneshot_ticks == 0)
+    return;
+
+  remaining = pit_read_count (0, &expired);
+  if (expired)
+    return;
+
+  /* Count the whole ticks passed, and carry the rest. */
+  elapsed = oneshot_start + (oneshot_count - remaining);
+  advance_ticks (elapsed / PIT_CYCLES_PER_TICK);
+  tick_carry = elapsed % PIT_CYCLES_PER_TICK;
+  oneshot_ticks = 0;
+  pit_configure_channel (0, 2, TIMER_FREQ);
+}
+
+/* Initializes callout C to call FUNC, passing AUX, once added
+   with timer_callout_add(). */
+void
+timer_callout_init (struct timer_callout *c, timer_callout_func *func,
+                    void *aux)
+{
+  ASSERT (c != NULL);
+  ASSERT (func != NULL);
+
+  c->func = func;
+  c->aux = aux;
+  c->pending = false;
+}
+
+/* Schedules callout C to run from the timer interrupt at timer
+   tick TICK, or at the next tick if TICK has already passed.  If
+   C is already pending, it is rescheduled.  May be called from
+   an interrupt handler, including from a callout function. */
+void
+timer_callout_add (struct timer_callout *c, int64_t tick)
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (c->pending)
+    list_remove (&c->elem);
+  c->expires = tick;
+  c->pending = true;
+  wheel_insert (c);
+
+  intr_set_level (old_level);
+}
+
+/* Cancels callout C.  Returns true if C was pending, false if it
+   had already run or was never added. */
+bool
+timer_callout_cancel (struct timer_callout *c)
+{
+  enum intr_level old_level = intr_disable ();
+  bool was_pending = c->pending;
+
+  if (was_pending)
+    {
+      list_remove (&c->elem);
+      c->pending = false;
+    }
+
+  intr_set_level (old_level);
+  return was_pending;
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
@@ -170,10 +381,40 @@ timer_print_stats (void)
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  ticks++;
+  bool expired = false;
+
+  if (oneshot_ticks > 0)
+    pit_read_count (0, &expired);
+
+  if (expired)
+    {
+      /* A tickless idle one-shot ran out, exactly ONESHOT_TICKS
+         after the last tick counted. */
+      advance_ticks (oneshot_ticks);
+      tick_carry = 0;
+      oneshot_ticks = 0;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+    }
+  else
+    {
+      /* A periodic tick.  If a one-shot is pending, this tick was
+         already pending when timer_idle_sleep() started it, and
+         the one-shot keeps counting. */
+      advance_ticks (1);
+    }
+  wheel_run ();
   thread_tick ();
 }
 
+/* Advances the tick count by CNT. */
+static void
+advance_ticks (int64_t cnt)
+{
+  seqlock_write_begin (&ticks_seq);
+  ticks += cnt;
+  seqlock_write_end (&ticks_seq);
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -244,3 +485,105 @@ real_time_delay (int64_t num, int32_t denom)
   ASSERT (denom % 1000 == 0);
   busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
 }
+
+/* Puts pending callout C into the wheel slot for its expiry
+   tick.  Must be called with interrupts off. */
+static void
+wheel_insert (struct timer_callout *c)
+{
+  int64_t expires = c->expires;
+  int64_t delta = expires - wheel_ticks;
+  int level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (delta < 0)
+    {
+      /* Already due: run at the next tick the wheel processes. */
+      expires = wheel_ticks;
+      delta = 0;
+    }
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < (int64_t) 1 << (WHEEL_BITS * (level + 1)))
+      break;
+  if (delta >= (int64_t) 1 << (WHEEL_BITS * (level + 1)))
+    {
+      /* Beyond the wheel's span: park in the farthest top slot,
+         to be re-added when that slot cascades. */
+      expires = wheel_ticks + ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    }
+
+  list_push_back (&wheel[level][(expires >> (WHEEL_BITS * level))
+                                & WHEEL_MASK],
+                  &c->elem);
+}
+
+/* Re-adds the callouts in the due slot of LEVEL, so that they
+   move to finer slots.  Must be called with interrupts off. */
+static void
+wheel_cascade (int level)
+{
+  struct list *slot = &wheel[level][(wheel_ticks >> (WHEEL_BITS * level))
+                                    & WHEEL_MASK];
+  struct list due;
+
+  /* Move the slot aside first, since a callout may land back in
+     the same slot. */
+  list_init (&due);
+  while (!list_empty (slot))
+    list_push_back (&due, list_pop_front (slot));
+  while (!list_empty (&due))
+    wheel_insert (list_entry (list_pop_front (&due),
+                              struct timer_callout, elem));
+}
+
+/* Runs every callout that has come due, advancing the wheel up
+   to the current tick.  Called from the timer interrupt. */
+static void
+wheel_run (void)
+{
+  while (wheel_ticks <= ticks)
+    {
+      struct list *slot = &wheel[0][wheel_ticks & WHEEL_MASK];
+      int level;
+
+      /* Every WHEEL_SIZE**LEVEL ticks, the due slot of LEVEL
+         moves down. */
+      for (level = 1; level < WHEEL_LEVELS; level++)
+        {
+          if ((wheel_ticks & (((int64_t) 1 << (WHEEL_BITS * level)) - 1))
+              != 0)
+            break;
+          wheel_cascade (level);
+        }
+
+      while (!list_empty (slot))
+        {
+          struct timer_callout *c =
+              list_entry (list_pop_front (slot), struct timer_callout, elem);
+          c->pending = false;
+          c->func (c->aux);
+        }
+
+      wheel_ticks++;
+    }
+}
+
+/* Returns the number of ticks from now until the first tick
+   that has callouts to run or a cascade to do, up to
+   TICKLESS_MAX_TICKS.  Must be called with interrupts off. */
+static int
+ticks_until_due (void)
+{
+  int n;
+
+  for (n = 1; n < TICKLESS_MAX_TICKS; n++)
+    {
+      int64_t tick = ticks + n;
+      if ((tick & WHEEL_MASK) == 0
+          || !list_empty (&wheel[0][tick & WHEEL_MASK]))
+        break;
+    }
+  return n;
+}
@@ -1,12 +1,29 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* Function run by a callout from the timer interrupt, given
+   auxiliary data AUX.  It runs in an external interrupt context,
+   so it must not sleep. */
+typedef void timer_callout_func (void *aux);
+
+/* A function call scheduled for a given timer tick. */
+struct timer_callout
+  {
+    struct list_elem elem;      /* Element in a timer wheel slot. */
+    int64_t expires;            /* Tick at which to run. */
+    timer_callout_func *func;   /* Function to call. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    bool pending;               /* True while in the timer wheel. */
+  };
+
 void timer_init (void);
 void timer_calibrate (void);
 
@@ -24,6 +41,20 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+/* If true, the idle thread stops the periodic timer interrupt
+   while no callout is due.  Controlled by kernel command-line
+   option "-tickless". */
+extern bool timer_tickless;
+
+void timer_idle_sleep (void);
+void timer_idle_wake (void);
+
+/* Callouts. */
+void timer_callout_init (struct timer_callout *, timer_callout_func *,
+                         void *aux);
+void timer_callout_add (struct timer_callout *, int64_t tick);
+bool timer_callout_cancel (struct timer_callout *);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
@@ -0,0 +1,426 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+/* Buffer cache.
+
+   All file system access to fs_device goes through a cache of
+   cache_sector_cnt sectors.  Reads are served from the cache when
+   possible, and writes only mark a cached sector dirty; dirty
+   sectors reach the disk when they are evicted, when the
+   write-behind work runs every FLUSH_INTERVAL ticks, or when
+   cache_flush() is called at shutdown.  Victims are chosen by the
+   clock algorithm.  cache_prefetch() asks for a sector to be
+   read in the background, for read-ahead; a prefetched sector
+   starts out not accessed, so that it is evicted first if it is
+   never used.
+
+   cache_lock protects the mapping from sectors to entries, and
+   each entry's pin count and accessed bit.  A pinned entry is
+   never evicted.  Each entry's own lock protects its data, and is
+   held across the disk I/O that fills or cleans it, so that I/O
+   on one entry does not hold up the others.  A thread takes
+   cache_lock and then releases it before taking an entry lock,
+   never the other way around.  No disk I/O is done holding
+   cache_lock: a dirty victim is written back under its entry
+   lock while it still holds its old sector, so that a thread
+   that wants that sector meanwhile waits for the write instead
+   of reading stale data from disk. */
+
+/* Ticks between write-behind passes. */
+#define FLUSH_INTERVAL (5 * TIMER_FREQ)
+
+/* Most prefetch requests waiting at once.  Further requests are
+   dropped. */
+#define PREFETCH_CNT 32
+
+/* A cached sector. */
+struct cache_entry
+  {
+    struct hash_elem elem;      /* Element in `sectors'. */
+    block_sector_t sector;      /* Sector held, if in `sectors'. */
+    int pin_cnt;                /* Number of users; evictable if 0. */
+    bool accessed;              /* Used since the clock hand passed? */
+    struct lock lock;           /* Protects the members below. */
+    bool valid;                 /* Does DATA hold the sector? */
+    bool dirty;                 /* Does DATA differ from disk? */
+    uint8_t data[BLOCK_SECTOR_SIZE]; /* Sector contents. */
+  };
+
+size_t cache_sector_cnt = CACHE_DEFAULT_CNT;
+
+static struct cache_entry *entries;     /* All entries. */
+static struct hash sectors;             /* Entries that hold a sector. */
+static size_t clock_hand;               /* Next eviction candidate. */
+static struct lock cache_lock;          /* Protects the above. */
+static struct condition unpinned;       /* Signaled when a pin drops. */
+
+static struct work flush_work;          /* Periodic write-behind. */
+
+/* Sectors to prefetch, a ring protected by cache_lock. */
+static block_sector_t prefetch_ring[PREFETCH_CNT];
+static size_t prefetch_head;            /* Index of oldest request. */
+static size_t prefetch_cnt;             /* Number of requests. */
+static struct work prefetch_work;       /* Reads them in. */
+
+static hash_hash_func entry_hash;
+static hash_less_func entry_less;
+static work_func flush_work_func;
+static work_func prefetch_work_func;
+static struct cache_entry *cache_get (block_sector_t, bool read);
+static void cache_put (struct cache_entry *, bool dirty);
+static struct cache_entry *lookup (block_sector_t);
+static struct cache_entry *evict (void);
+static bool write_back (struct cache_entry *);
+
+/* Initializes the buffer cache and starts write-behind. */
+void
+cache_init (void)
+{
+  size_t i;
+
+  ASSERT (cache_sector_cnt > 0);
+
+  entries = calloc (cache_sector_cnt, sizeof *entries);
+  if (entries == NULL || !hash_init (&sectors, entry_hash, entry_less, NULL))
+    PANIC ("can't allocate %zu-sector buffer cache", cache_sector_cnt);
+  for (i = 0; i < cache_sector_cnt; i++)
+    lock_init (&entries[i].lock);
+  clock_hand = 0;
+  lock_init (&cache_lock);
+  cond_init (&unpinned);
+
+  work_init (&flush_work, flush_work_func, WORK_PRI_LOW);
+  queue_delayed_work (&flush_work, FLUSH_INTERVAL);
+  work_init (&prefetch_work, prefetch_work_func, WORK_PRI_NORMAL);
+}
+
+/* Reads sector SECTOR into BUFFER, which must have room for
+   BLOCK_SECTOR_SIZE bytes. */
+void
+cache_read (block_sector_t sector, void *buffer)
+{
+  cache_read_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Reads SIZE bytes starting at byte offset OFS within sector
+   SECTOR into BUFFER. */
+void
+cache_read_at (block_sector_t sector, void *buffer, size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = cache_get (sector, true);
+  memcpy (buffer, e->data + ofs, size);
+  cache_put (e, false);
+}
+
+/* Writes sector SECTOR from BUFFER, which must contain
+   BLOCK_SECTOR_SIZE bytes. */
+void
+cache_write (block_sector_t sector, const void *buffer)
+{
+  cache_write_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Writes SIZE bytes from BUFFER to sector SECTOR, starting at
+   byte offset OFS within the sector.  Only a write of part of a
+   sector that is not cached has to read the sector first. */
+void
+cache_write_at (block_sector_t sector, const void *buffer,
+                size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = cache_get (sector, size < BLOCK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  e->valid = true;
+  cache_put (e, true);
+}
+
+/* Writes every dirty sector in the cache to disk. */
+void
+cache_flush (void)
+{
+  size_t i;
+
+  for (i = 0; i < cache_sector_cnt; i++)
+    {
+      struct cache_entry *e = &entries[i];
+      bool in_use;
+
+      lock_acquire (&cache_lock);
+      in_use = lookup (e->sector) == e;
+      if (in_use)
+        e->pin_cnt++;
+      lock_release (&cache_lock);
+      if (!in_use)
+        continue;
+
+      lock_acquire (&e->lock);
+      if (e->valid && e->dirty)
+        {
+          block_write (fs_device, e->sector, e->data);
+          e->dirty = false;
+        }
+      cache_put (e, false);
+    }
+}
+
+/* Asks for SECTOR to be read into the cache in the background,
+   unless it is already cached. */
+void
+cache_prefetch (block_sector_t sector)
+{
+  bool queued = false;
+
+  lock_acquire (&cache_lock);
+  if (prefetch_cnt < PREFETCH_CNT && lookup (sector) == NULL)
+    {
+      prefetch_ring[(prefetch_head + prefetch_cnt++) % PREFETCH_CNT] = sector;
+      queued = true;
+    }
+  lock_release (&cache_lock);
+
+  if (queued)
+    queue_work (&prefetch_work);
+}
+
+/* Returns the entry for SECTOR, pinned and locked, loading it
+   into the cache if necessary.  If READ is false, the caller is
+   about to overwrite the whole sector, so a newly loaded entry
+   is left invalid instead of being read from disk. */
+static struct cache_entry *
+cache_get (block_sector_t sector, bool read)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  e = lookup (sector);
+  if (e == NULL)
+    {
+      struct cache_entry *victim = evict ();
+
+      /* evict() may have dropped cache_lock, so another thread
+         may have brought in SECTOR meanwhile. */
+      e = lookup (sector);
+      if (e == NULL)
+        {
+          e = victim;
+          e->sector = sector;
+          e->valid = false;
+          hash_insert (&sectors, &e->elem);
+        }
+    }
+  e->pin_cnt++;
+  e->accessed = true;
+  lock_release (&cache_lock);
+
+  lock_acquire (&e->lock);
+  if (!e->valid && read)
+    {
+      block_read (fs_device, sector, e->data);
+      e->valid = true;
+    }
+  return e;
+}
+
+/* Unlocks and unpins entry E, which the caller obtained from
+   cache_get(), marking it dirty if DIRTY is true. */
+static void
+cache_put (struct cache_entry *e, bool dirty)
+{
+  if (dirty)
+    e->dirty = true;
+  lock_release (&e->lock);
+
+  lock_acquire (&cache_lock);
+  ASSERT (e->pin_cnt > 0);
+  if (--e->pin_cnt == 0)
+    cond_signal (&unpinned, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Returns the entry that holds SECTOR, or a null pointer if
+   SECTOR is not cached.  Must be called with cache_lock held. */
+static struct cache_entry *
+lookup (block_sector_t sector)
+{
+  struct cache_entry key;
+  struct hash_elem *elem;
+
+  key.sector = sector;
+  elem = hash_find (&sectors, &key.elem);
+  return elem != NULL ? hash_entry (elem, struct cache_entry, elem) : NULL;
+}
+
+/* Chooses an unpinned entry by the clock algorithm, writes it
+   back if it is dirty, and returns it, clean and no longer in
+   `sectors'.  Waits for an entry to be unpinned if all of them
+   are pinned.  Must be called with cache_lock held, which may be
+   released and reacquired meanwhile, so the caller must look up
+   its sector again afterward.  The flusher keeps most victims
+   clean. */
+static struct cache_entry *
+evict (void)
+{
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (;;)
+    {
+      bool wrote = false;
+      size_t i;
+
+      /* Two sweeps clear every accessed bit on the way, so the
+         second must find any unpinned entry. */
+      for (i = 0; i < 2 * cache_sector_cnt && !wrote; i++)
+        {
+          struct cache_entry *e = &entries[clock_hand];
+          clock_hand = (clock_hand + 1) % cache_sector_cnt;
+
+          if (e->pin_cnt > 0)
+            continue;
+          if (e->accessed)
+            {
+              e->accessed = false;
+              continue;
+            }
+
+          if (lookup (e->sector) == e)
+            {
+              if (e->valid && e->dirty)
+                {
+                  /* Whether or not E could be taken, cache_lock
+                     was dropped, so the entries seen so far may
+                     have changed: start a new pass. */
+                  if (write_back (e))
+                    return e;
+                  wrote = true;
+                  continue;
+                }
+              hash_delete (&sectors, &e->elem);
+            }
+          e->dirty = false;
+          return e;
+        }
+      if (!wrote)
+        cond_wait (&unpinned, &cache_lock);
+    }
+}
+
+/* Writes dirty entry E, which is unpinned and in `sectors', back
+   to disk for evict(), releasing cache_lock during the write.  E
+   stays in `sectors', pinned, with the write done under its
+   lock, so that a thread that wants E's sector meanwhile waits
+   for it.  Returns true, with E removed from `sectors', if E is
+   still clean and unused afterward; otherwise, returns false,
+   leaving E cached.  Must be called with cache_lock held. */
+static bool
+write_back (struct cache_entry *e)
+{
+  e->pin_cnt++;
+  lock_release (&cache_lock);
+
+  lock_acquire (&e->lock);
+  if (e->valid && e->dirty)
+    {
+      block_write (fs_device, e->sector, e->data);
+      e->dirty = false;
+    }
+  lock_release (&e->lock);
+
+  lock_acquire (&cache_lock);
+  if (--e->pin_cnt > 0 || e->accessed || e->dirty)
+    {
+      if (e->pin_cnt == 0)
+        cond_signal (&unpinned, &cache_lock);
+      return false;
+    }
+  hash_delete (&sectors, &e->elem);
+  return true;
+}
+
+/* Returns a hash of the sector held by entry E_. */
+static unsigned
+entry_hash (const struct hash_elem *e_, void *aux UNUSED)
+{
+  const struct cache_entry *e = hash_entry (e_, struct cache_entry, elem);
+  return hash_int (e->sector);
+}
+
+/* Returns true if entry A_ holds a lower sector than entry B_. */
+static bool
+entry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct cache_entry *a = hash_entry (a_, struct cache_entry, elem);
+  const struct cache_entry *b = hash_entry (b_, struct cache_entry, elem);
+  return a->sector < b->sector;
+}
+
+/* Reads in the sectors requested with cache_prefetch() that are
+   still not cached. */
+static void
+prefetch_work_func (struct work *w UNUSED)
+{
+  for (;;)
+    {
+      struct cache_entry *e;
+      block_sector_t sector;
+
+      lock_acquire (&cache_lock);
+      if (prefetch_cnt == 0)
+        {
+          lock_release (&cache_lock);
+          break;
+        }
+      sector = prefetch_ring[prefetch_head];
+      prefetch_head = (prefetch_head + 1) % PREFETCH_CNT;
+      prefetch_cnt--;
+      if (lookup (sector) != NULL)
+        {
+          lock_release (&cache_lock);
+          continue;
+        }
+      e = evict ();
+      if (lookup (sector) != NULL)
+        {
+          /* Read in by someone else while evict() waited. */
+          lock_release (&cache_lock);
+          continue;
+        }
+      e->sector = sector;
+      e->valid = false;
+      hash_insert (&sectors, &e->elem);
+      e->pin_cnt++;
+      e->accessed = false;
+      lock_release (&cache_lock);
+
+      lock_acquire (&e->lock);
+      if (!e->valid)
+        {
+          block_read (fs_device, sector, e->data);
+          e->valid = true;
+        }
+      cache_put (e, false);
+    }
+}
+
+/* Write-behind: flushes the cache, then queues itself to run
+   again after FLUSH_INTERVAL ticks. */
+static void
+flush_work_func (struct work *w)
+{
+  cache_flush ();
+  queue_delayed_work (w, FLUSH_INTERVAL);
+}
@@ -0,0 +1,22 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Default number of sectors in the buffer cache. */
+#define CACHE_DEFAULT_CNT 64
+
+/* Number of sectors in the buffer cache.  Controlled by kernel
+   command-line option "-cache=COUNT". */
+extern size_t cache_sector_cnt;
+
+void cache_init (void);
+void cache_read (block_sector_t, void *);
+void cache_read_at (block_sector_t, void *, size_t ofs, size_t size);
+void cache_write (block_sector_t, const void *);
+void cache_write_at (block_sector_t, const void *, size_t ofs, size_t size);
+void cache_flush (void);
+void cache_prefetch (block_sector_t);
+
+#endif /* filesys/cache.h */
@@ -0,0 +1,189 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/synch.h"
+
+/* Directory entry cache.
+
+   Remembers the results of recent name lookups in directories,
+   so that looking up the same name again, as when a program is
+   run over and over, does not search the directory.  Each entry
+   maps a directory's inode sector and a name to the inode sector
+   the name refers to, or records that the directory has no such
+   name (a "negative" entry).  Entries are replaced in least
+   recently used order.
+
+   The directory code calls dcache_invalidate() whenever it adds
+   or removes a name.  A lookup that misses reads a generation
+   number, which every invalidation advances, and hands it back
+   to dcache_insert() along with what it found in the directory.
+   If the generation has moved on, the directory may have changed
+   during the search, so the result is not cached. */
+
+/* Number of entries in the cache. */
+#define DCACHE_CNT 64
+
+/* A cached lookup result. */
+struct dcache_entry
+  {
+    struct hash_elem hash_elem;         /* Element in `names'. */
+    struct list_elem lru_elem;          /* Element in `lru'. */
+    bool in_use;                        /* In `names'? */
+    block_sector_t dir;                 /* Directory's inode sector. */
+    char name[NAME_MAX + 1];            /* Name looked up. */
+    bool found;                         /* Does DIR contain NAME? */
+    block_sector_t inode_sector;        /* NAME's inode, if found. */
+  };
+
+static struct dcache_entry entries[DCACHE_CNT];
+static struct hash names;               /* Entries in use. */
+static struct list lru;                 /* All entries, most recent first. */
+static unsigned generation;             /* Advanced by invalidation. */
+static struct lock dcache_lock;         /* Protects all of the above. */
+
+static hash_hash_func entry_hash;
+static hash_less_func entry_less;
+static struct dcache_entry *lookup (block_sector_t dir, const char *name);
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void)
+{
+  size_t i;
+
+  if (!hash_init (&names, entry_hash, entry_less, NULL))
+    PANIC ("can't create directory entry cache");
+  list_init (&lru);
+  for (i = 0; i < DCACHE_CNT; i++)
+    {
+      entries[i].in_use = false;
+      list_push_back (&lru, &entries[i].lru_elem);
+    }
+  lock_init (&dcache_lock);
+}
+
+/* Looks up NAME in the directory whose inode is in sector DIR.
+   On a hit, returns true and sets *FOUND to whether DIR contains
+   NAME and, if it does, *INODE_SECTOR to NAME's inode sector.
+   On a miss, returns false and sets *GEN to the generation to
+   pass to dcache_insert() once DIR has been searched. */
+bool
+dcache_lookup (block_sector_t dir, const char *name,
+               bool *found, block_sector_t *inode_sector, unsigned *gen)
+{
+  struct dcache_entry *e;
+
+  lock_acquire (&dcache_lock);
+  e = lookup (dir, name);
+  if (e != NULL)
+    {
+      list_remove (&e->lru_elem);
+      list_push_front (&lru, &e->lru_elem);
+      *found = e->found;
+      *inode_sector = e->inode_sector;
+    }
+  else
+    *gen = generation;
+  lock_release (&dcache_lock);
+
+  return e != NULL;
+}
+
+/* Records that the directory whose inode is in sector DIR
+   contains NAME, with its inode in INODE_SECTOR, if FOUND is
+   true, or that it does not contain NAME, if FOUND is false.
+   GEN must be the generation that dcache_lookup() returned
+   before DIR was searched. */
+void
+dcache_insert (block_sector_t dir, const char *name,
+               bool found, block_sector_t inode_sector, unsigned gen)
+{
+  struct dcache_entry *e;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  if (gen == generation && lookup (dir, name) == NULL)
+    {
+      /* Reuse the least recently used entry. */
+      e = list_entry (list_back (&lru), struct dcache_entry, lru_elem);
+      if (e->in_use)
+        hash_delete (&names, &e->hash_elem);
+
+      e->in_use = true;
+      e->dir = dir;
+      strlcpy (e->name, name, sizeof e->name);
+      e->found = found;
+      e->inode_sector = inode_sector;
+      hash_insert (&names, &e->hash_elem);
+      list_remove (&e->lru_elem);
+      list_push_front (&lru, &e->lru_elem);
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Forgets anything cached about NAME in the directory whose
+   inode is in sector DIR, which is about to gain or lose NAME. */
+void
+dcache_invalidate (block_sector_t dir, const char *name)
+{
+  struct dcache_entry *e;
+
+  lock_acquire (&dcache_lock);
+  generation++;
+  e = lookup (dir, name);
+  if (e != NULL)
+    {
+      hash_delete (&names, &e->hash_elem);
+      e->in_use = false;
+      list_remove (&e->lru_elem);
+      list_push_back (&lru, &e->lru_elem);
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Returns the entry for NAME in DIR, or a null pointer if there
+   is none.  The caller must hold dcache_lock. */
+static struct dcache_entry *
+lookup (block_sector_t dir, const char *name)
+{
+  struct dcache_entry key;
+  struct hash_elem *e;
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+
+  key.dir = dir;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&names, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dcache_entry, hash_elem) : NULL;
+}
+
+/* Returns a hash value for the entry that contains E. */
+static unsigned
+entry_hash (const struct hash_elem *e_, void *aux UNUSED)
+{
+  const struct dcache_entry *e
+    = hash_entry (e_, struct dcache_entry, hash_elem);
+  return hash_string (e->name) ^ hash_int (e->dir);
+}
+
+/* Returns true if the entry that contains A precedes the one that
+   contains B. */
+static bool
+entry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct dcache_entry *a
+    = hash_entry (a_, struct dcache_entry, hash_elem);
+  const struct dcache_entry *b
+    = hash_entry (b_, struct dcache_entry, hash_elem);
+
+  if (a->dir != b->dir)
+    return a->dir < b->dir;
+  return strcmp (a->name, b->name) < 0;
+}
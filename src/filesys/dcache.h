@@ -0,0 +1,15 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+void dcache_init (void);
+bool dcache_lookup (block_sector_t dir, const char *name,
+                    bool *found, block_sector_t *inode_sector,
+                    unsigned *gen);
+void dcache_insert (block_sector_t dir, const char *name,
+                    bool found, block_sector_t inode_sector, unsigned gen);
+void dcache_invalidate (block_sector_t dir, const char *name);
+
+#endif /* filesys/dcache.h */
@@ -1,16 +1,45 @@
 #include "filesys/directory.h"
+#include <hash.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
-/* A directory. */
+/* A directory.
+
+   A directory is a file of directory entries, in one of two
+   formats.  In the original linear format, the file is just an
+   array of entries, searched from the start.
+
+   In the hashed format, which dir_create() makes, the file is
+   divided into sector-sized blocks.  Block 0 holds a struct
+   dir_header, and each other block holds a struct dir_block.  A
+   name hashes to one of the header's buckets, and each bucket is
+   a chain of blocks linked through their `next' members, so that
+   finding a name usually takes one read of the header and one of
+   a block.  Buckets are added one at a time by linear hashing,
+   splitting the next bucket in turn, as the directory fills up,
+   until there are DIR_MAX_BUCKETS of them; after that, chains
+   just grow longer.
+
+   The two formats are told apart by the header's magic number,
+   which is too large to be the sector number at the start of a
+   linear directory's first entry.
+
+   Each operation holds the directory inode's directory lock
+   throughout, as a reader if it only looks, or as a writer if
+   it changes the directory. */
 struct dir 
   {
     struct inode *inode;                /* Backing store. */
     off_t pos;                          /* Current position. */
+    struct dir_header *header;          /* Header, hashed format only. */
+    struct dir_block *block;            /* Block being worked on. */
   };
 
 /* A single directory entry. */
@@ -21,12 +50,81 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Identifies a hashed directory. */
+#define DIR_MAGIC 0x48534944
+
+/* Number of entries in a block of a hashed directory. */
+#define DIR_BLOCK_ENTRY_CNT 25
+
+/* Most buckets in a hashed directory. */
+#define DIR_MAX_BUCKETS 125
+
+/* Header of a hashed directory, in its block 0.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct dir_header
+  {
+    uint32_t magic;                     /* DIR_MAGIC. */
+    uint32_t bucket_cnt;                /* Number of buckets. */
+    uint32_t entry_cnt;                 /* Number of entries in use. */
+    uint32_t buckets[DIR_MAX_BUCKETS];  /* First block in each bucket. */
+  };
+
+/* A block of a hashed directory.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct dir_block
+  {
+    struct dir_entry entries[DIR_BLOCK_ENTRY_CNT];
+    uint32_t next;                      /* Next block in bucket, or 0. */
+    uint32_t unused[2];                 /* Not used. */
+  };
+
+static bool read_header (const struct dir *);
+static bool write_header (struct dir *);
+static bool read_block (const struct dir *, size_t block);
+static bool write_block (struct dir *, size_t block,
+                         const struct dir_block *);
+static size_t block_cnt (const struct dir *);
+static off_t entry_ofs (size_t block, size_t idx);
+static size_t bucket_of (const struct dir_header *, const char *name);
+static bool split_bucket (struct dir *);
+static off_t append_block (struct dir *, const char *name);
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir_header *h;
+  struct inode *inode;
+  size_t i;
+  bool success = false;
+
+  ASSERT (sizeof (struct dir_header) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct dir_block) == BLOCK_SECTOR_SIZE);
+
+  h = calloc (1, sizeof *h);
+  if (h == NULL)
+    return false;
+  h->magic = DIR_MAGIC;
+  h->bucket_cnt = DIV_ROUND_UP (entry_cnt, DIR_BLOCK_ENTRY_CNT);
+  if (h->bucket_cnt < 1)
+    h->bucket_cnt = 1;
+  else if (h->bucket_cnt > DIR_MAX_BUCKETS)
+    h->bucket_cnt = DIR_MAX_BUCKETS;
+  for (i = 0; i < h->bucket_cnt; i++)
+    h->buckets[i] = i + 1;
+
+  /* Each bucket starts out as one empty block.  Blocks that have
+     never been written read as zeros, which is an empty block. */
+  if (inode_create (sector, (h->bucket_cnt + 1) * BLOCK_SECTOR_SIZE))
+    {
+      inode = inode_open (sector);
+      success = (inode != NULL
+                 && inode_write_at (inode, h, sizeof *h, 0) == sizeof *h);
+      inode_close (inode);
+    }
+  free (h);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -35,7 +133,9 @@ struct dir *
 dir_open (struct inode *inode) 
 {
   struct dir *dir = calloc (1, sizeof *dir);
-  if (inode != NULL && dir != NULL)
+  if (inode != NULL && dir != NULL
+      && (dir->header = malloc (sizeof *dir->header)) != NULL
+      && (dir->block = malloc (sizeof *dir->block)) != NULL)
     {
       dir->inode = inode;
       dir->pos = 0;
@@ -44,6 +144,8 @@ dir_open (struct inode *inode)
   else
     {
       inode_close (inode);
+      if (dir != NULL)
+        free (dir->header);
       free (dir);
       return NULL; 
     }
@@ -72,6 +174,8 @@ dir_close (struct dir *dir)
   if (dir != NULL)
     {
       inode_close (dir->inode);
+      free (dir->header);
+      free (dir->block);
       free (dir);
     }
 }
@@ -87,47 +191,112 @@ dir_get_inode (struct dir *dir)
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+
+   If FREEP is non-null, also sets *FREEP to the offset of the
+   first free slot passed where NAME could be added, so that
+   adding a name takes only one pass.  In a linear directory,
+   the slot at end of file counts as free.  In a hashed
+   directory, *FREEP is set to -1 if NAME's bucket is full. */
 static bool
 lookup (const struct dir *dir, const char *name,
-        struct dir_entry *ep, off_t *ofsp) 
+        struct dir_entry *ep, off_t *ofsp, off_t *freep) 
 {
-  struct dir_entry e;
-  size_t ofs;
-  
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
-      }
+  if (freep != NULL)
+    *freep = -1;
+
+  if (read_header (dir))
+    {
+      /* Hashed directory: search NAME's bucket. */
+      struct dir_block *b = dir->block;
+      size_t block;
+
+      for (block = dir->header->buckets[bucket_of (dir->header, name)];
+           block != 0 && read_block (dir, block); block = b->next)
+        {
+          size_t i;
+
+          for (i = 0; i < DIR_BLOCK_ENTRY_CNT; i++)
+            {
+              struct dir_entry *e = &b->entries[i];
+
+              if (e->in_use && !strcmp (name, e->name))
+                {
+                  if (ep != NULL)
+                    *ep = *e;
+                  if (ofsp != NULL)
+                    *ofsp = entry_ofs (block, i);
+                  return true;
+                }
+              else if (!e->in_use && freep != NULL && *freep == -1)
+                *freep = entry_ofs (block, i);
+            }
+        }
+    }
+  else
+    {
+      /* Linear directory: search the whole file. */
+      struct dir_entry e;
+      size_t ofs;
+
+      for (ofs = 0;
+           inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+           ofs += sizeof e) 
+        if (e.in_use && !strcmp (name, e.name)) 
+          {
+            if (ep != NULL)
+              *ep = e;
+            if (ofsp != NULL)
+              *ofsp = ofs;
+            return true;
+          }
+        else if (!e.in_use && freep != NULL && *freep == -1)
+          *freep = ofs;
+
+      /* inode_read_at() will only return a short read at end of
+         file.  Otherwise, we'd need to verify that we didn't get a
+         short read due to something intermittent such as low
+         memory. */
+      if (freep != NULL && *freep == -1)
+        *freep = ofs;
+    }
   return false;
 }
 
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
-   a null pointer.  The caller must close *INODE. */
+   a null pointer.  The caller must close *INODE.
+   Consults the directory entry cache first, and on a miss adds
+   what it finds, or that NAME is not there, to the cache. */
 bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
+  block_sector_t dir_sector, inode_sector;
   struct dir_entry e;
+  bool found;
+  unsigned gen;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
-  else
-    *inode = NULL;
+  /* Hold the directory lock until the inode is open, so that
+     the file cannot be removed, and its sector reused, between
+     finding it and opening it. */
+  rwlock_read_acquire (inode_dir_lock (dir->inode));
+  dir_sector = inode_get_inumber (dir->inode);
+  if (!dcache_lookup (dir_sector, name, &found, &inode_sector, &gen))
+    {
+      found = lookup (dir, name, &e, NULL, NULL);
+      inode_sector = found ? e.inode_sector : 0;
+      dcache_insert (dir_sector, name, found, inode_sector, gen);
+    }
+  *inode = found ? inode_open (inode_sector) : NULL;
+  rwlock_read_release (inode_dir_lock (dir->inode));
 
   return *inode != NULL;
 }
@@ -141,40 +310,61 @@ dir_lookup (const struct dir *dir, const char *name,
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
+  struct dir_header *h;
   struct dir_entry e;
   off_t ofs;
   bool success = false;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
+  h = dir->header;
 
   /* Check NAME for validity. */
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  /* Check that NAME is not in use, and find a free slot. */
+  rwlock_write_acquire (inode_dir_lock (dir->inode));
+  if (lookup (dir, name, NULL, NULL, &ofs))
     goto done;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
-
-  /* Write slot. */
+  if (h->magic == DIR_MAGIC)
+    {
+      /* Add a bucket if the directory is getting full.  That may
+         move NAME to another bucket, so look again. */
+      if (h->entry_cnt >= h->bucket_cnt * DIR_BLOCK_ENTRY_CNT * 3 / 4
+          && h->bucket_cnt < DIR_MAX_BUCKETS)
+        {
+          split_bucket (dir);
+          lookup (dir, name, NULL, NULL, &ofs);
+        }
+
+      /* If NAME's bucket is full, chain another block to it. */
+      if (ofs == -1)
+        {
+          ofs = append_block (dir, name);
+          if (ofs == -1)
+            goto done;
+        }
+    }
+
+  /* Write slot.  Invalidate the directory entry cache only
+     afterward, so that a concurrent lookup cannot cache what it
+     found before the write. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
+
+  if (success && h->magic == DIR_MAGIC)
+    {
+      h->entry_cnt++;
+      write_header (dir);
+    }
 
  done:
+  rwlock_write_release (inode_dir_lock (dir->inode));
   return success;
 }
 
@@ -193,7 +383,8 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  rwlock_write_acquire (inode_dir_lock (dir->inode));
+  if (!lookup (dir, name, &e, &ofs, NULL))
     goto done;
 
   /* Open inode. */
@@ -205,12 +396,19 @@ dir_remove (struct dir *dir, const char *name)
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
+  if (dir->header->magic == DIR_MAGIC)
+    {
+      dir->header->entry_cnt--;
+      write_header (dir);
+    }
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  rwlock_write_release (inode_dir_lock (dir->inode));
   inode_close (inode);
   return success;
 }
@@ -221,16 +419,221 @@ dir_remove (struct dir *dir, const char *name)
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
+  bool hashed, success = false;
   struct dir_entry e;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  rwlock_read_acquire (inode_dir_lock (dir->inode));
+  hashed = read_header (dir);
+  for (;;)
     {
+      if (hashed)
+        {
+          /* Skip the header and the end of each block. */
+          size_t block = dir->pos / BLOCK_SECTOR_SIZE;
+          size_t idx = dir->pos % BLOCK_SECTOR_SIZE / sizeof e;
+          if (block == 0 || idx >= DIR_BLOCK_ENTRY_CNT)
+            {
+              dir->pos = entry_ofs (block + 1, 0);
+              continue;
+            }
+        }
+
+      if (inode_read_at (dir->inode, &e, sizeof e, dir->pos) != sizeof e)
+        break;
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          success = true;
+          break;
         } 
     }
-  return false;
+  rwlock_read_release (inode_dir_lock (dir->inode));
+
+  return success;
+}
+
+/* Reads DIR's header into DIR->header.  Returns true if DIR is
+   in the hashed format, false if it is linear. */
+static bool
+read_header (const struct dir *dir)
+{
+  struct dir_header *h = dir->header;
+
+  if (inode_read_at (dir->inode, h, sizeof *h, 0) != sizeof *h
+      || h->magic != DIR_MAGIC)
+    {
+      h->magic = 0;
+      return false;
+    }
+  return true;
+}
+
+/* Writes DIR->header to DIR.  Returns true if successful, false
+   on failure. */
+static bool
+write_header (struct dir *dir)
+{
+  return (inode_write_at (dir->inode, dir->header, sizeof *dir->header, 0)
+          == sizeof *dir->header);
+}
+
+/* Reads block BLOCK of hashed directory DIR into DIR->block.
+   Returns true if successful, false on failure. */
+static bool
+read_block (const struct dir *dir, size_t block)
+{
+  return (inode_read_at (dir->inode, dir->block, sizeof *dir->block,
+                         entry_ofs (block, 0))
+          == sizeof *dir->block);
+}
+
+/* Writes B to block BLOCK of hashed directory DIR, growing DIR
+   if BLOCK is at its end.  Returns true if successful, false on
+   failure. */
+static bool
+write_block (struct dir *dir, size_t block, const struct dir_block *b)
+{
+  return (inode_write_at (dir->inode, b, sizeof *b, entry_ofs (block, 0))
+          == sizeof *b);
+}
+
+/* Returns the number of blocks in hashed directory DIR. */
+static size_t
+block_cnt (const struct dir *dir)
+{
+  return inode_length (dir->inode) / BLOCK_SECTOR_SIZE;
+}
+
+/* Returns the byte offset of entry IDX in block BLOCK of a
+   hashed directory. */
+static off_t
+entry_ofs (size_t block, size_t idx)
+{
+  return block * BLOCK_SECTOR_SIZE + idx * sizeof (struct dir_entry);
+}
+
+/* Returns the bucket that NAME belongs in, given header H.
+
+   With BUCKET_CNT buckets and LOW the greatest power of 2 not
+   above it, buckets below BUCKET_CNT - LOW have already been
+   split in two, so names are spread over 2 * LOW buckets, except
+   that names hashing to a bucket that does not exist yet stay in
+   the one it will be split from. */
+static size_t
+bucket_of (const struct dir_header *h, const char *name)
+{
+  unsigned hash = hash_string (name);
+  size_t low, bucket;
+
+  for (low = 1; low * 2 <= h->bucket_cnt; low *= 2)
+    continue;
+  bucket = hash % (low * 2);
+  if (bucket >= h->bucket_cnt)
+    bucket = hash % low;
+  return bucket;
+}
+
+/* Adds a bucket to hashed directory DIR, whose header must be in
+   DIR->header, by splitting the next bucket in turn, and writes
+   back the header.  Returns true if successful, false on
+   failure. */
+static bool
+split_bucket (struct dir *dir)
+{
+  struct dir_header *h = dir->header;
+  struct dir_block *old = dir->block;
+  struct dir_block *new;
+  size_t low, src, dst, block, new_block, new_idx;
+  bool success = true;
+
+  ASSERT (h->bucket_cnt < DIR_MAX_BUCKETS);
+
+  new = calloc (1, sizeof *new);
+  if (new == NULL)
+    return false;
+
+  /* Start the new bucket with an empty block at end of file. */
+  new_block = block_cnt (dir);
+  if (!write_block (dir, new_block, new))
+    {
+      free (new);
+      return false;
+    }
+  new_idx = 0;
+
+  for (low = 1; low * 2 <= h->bucket_cnt; low *= 2)
+    continue;
+  src = h->bucket_cnt - low;
+  dst = h->bucket_cnt++;
+  h->buckets[dst] = new_block;
+
+  /* Move the entries that now belong in DST.  Each block of the
+     new bucket is written before the block it took entries from,
+     so that a failure leaves entries in both buckets rather than
+     in neither. */
+  for (block = h->buckets[src]; block != 0 && read_block (dir, block);
+       block = old->next)
+    {
+      bool moved = false;
+      size_t i;
+
+      for (i = 0; i < DIR_BLOCK_ENTRY_CNT; i++)
+        {
+          struct dir_entry *e = &old->entries[i];
+          if (!e->in_use || bucket_of (h, e->name) != dst)
+            continue;
+
+          if (new_idx == DIR_BLOCK_ENTRY_CNT)
+            {
+              new->next = new_block + 1;
+              success = success && write_block (dir, new_block, new);
+              memset (new, 0, sizeof *new);
+              new_block++;
+              new_idx = 0;
+            }
+          new->entries[new_idx++] = *e;
+          e->in_use = false;
+          moved = true;
+        }
+
+      if (moved)
+        success = (success && write_block (dir, new_block, new)
+                   && write_block (dir, block, old));
+    }
+
+  free (new);
+  return write_header (dir) && success;
+}
+
+/* Chains a new, empty block to the end of the bucket for NAME in
+   hashed directory DIR, whose header must be in DIR->header, and
+   returns the offset of its first entry.  Returns -1 on
+   failure. */
+static off_t
+append_block (struct dir *dir, const char *name)
+{
+  struct dir_block *b = dir->block;
+  size_t new_block = block_cnt (dir);
+  size_t tail;
+
+  /* Find the bucket's last block. */
+  tail = dir->header->buckets[bucket_of (dir->header, name)];
+  for (;;)
+    {
+      if (!read_block (dir, tail))
+        return -1;
+      if (b->next == 0)
+        break;
+      tail = b->next;
+    }
+
+  /* Write a new block, then link it in. */
+  memset (b, 0, sizeof *b);
+  if (!write_block (dir, new_block, b) || !read_block (dir, tail))
+    return -1;
+  b->next = new_block;
+  if (!write_block (dir, tail, b))
+    return -1;
+  return entry_ofs (new_block, 0);
 }
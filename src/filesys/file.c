@@ -1,5 +1,6 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include "devices/block.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
@@ -9,8 +10,21 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    off_t ra_next;              /* Offset a sequential read would
+                                   start at. */
+    off_t ra_window;            /* Bytes to read ahead, 0 if the file
+                                   is not being read sequentially. */
+    off_t ra_end;               /* End of data already read ahead. */
   };
 
+/* Read-ahead window for sequential reads: starts at RA_MIN_WINDOW
+   bytes and doubles with each further sequential read, up to
+   RA_MAX_WINDOW bytes. */
+#define RA_MIN_WINDOW (2 * BLOCK_SECTOR_SIZE)
+#define RA_MAX_WINDOW (16 * BLOCK_SECTOR_SIZE)
+
+static void read_ahead (struct file *, off_t ofs, off_t size);
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
@@ -69,6 +83,7 @@ off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
   off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  read_ahead (file, file->pos, bytes_read);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -87,9 +102,8 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
+   Writing past end of file grows the file.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
@@ -102,9 +116,8 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
+   Writing past end of file grows the file.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -166,3 +179,38 @@ file_tell (struct file *file)
   ASSERT (file != NULL);
   return file->pos;
 }
+
+/* Notes that SIZE bytes at OFS were just read from FILE.  If
+   that continues a sequential run of reads, grows the read-ahead
+   window and starts reading ahead whatever part of the window
+   past the read has not been read ahead already.  Otherwise,
+   stops reading ahead. */
+static void
+read_ahead (struct file *file, off_t ofs, off_t size)
+{
+  off_t start, end;
+
+  if (size == 0)
+    return;
+
+  if (ofs != file->ra_next)
+    {
+      file->ra_window = 0;
+      file->ra_end = 0;
+    }
+  else if (file->ra_window == 0)
+    file->ra_window = RA_MIN_WINDOW;
+  else if (file->ra_window < RA_MAX_WINDOW)
+    file->ra_window *= 2;
+  file->ra_next = ofs + size;
+
+  if (file->ra_window == 0)
+    return;
+  start = file->ra_end > file->ra_next ? file->ra_end : file->ra_next;
+  end = file->ra_next + file->ra_window;
+  if (end > start)
+    {
+      inode_readahead (file->inode, end - start, start);
+      file->ra_end = end;
+    }
+}
@@ -2,18 +2,16 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
-#include "threads/synch.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
-/* Lock for any file system operations. */
-static struct lock filesys_lock;
-
 static void do_format (void);
 
 /* Initializes the file system module.
@@ -25,8 +23,8 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
-  lock_init (&filesys_lock);
-
+  cache_init ();
+  dcache_init ();
   inode_init ();
   free_map_init ();
 
@@ -42,6 +40,7 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  cache_flush ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -96,22 +95,6 @@ filesys_remove (const char *name)
   return success;
 }
 
-/* Acquires filesystem lock. */
-void
-filesys_lock_acquire (void)
-{
-  if (!lock_held_by_current_thread (&filesys_lock))
-    lock_acquire (&filesys_lock);
-}
-
-/* Releases filesystem lock. */
-void
-filesys_lock_release (void)
-{
-  if (lock_held_by_current_thread (&filesys_lock))
-    lock_release (&filesys_lock);
-}
-
 
 /* Formats the file system. */
 static void
@@ -17,7 +17,4 @@ bool filesys_create (const char *name, off_t initial_size);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
 
-void filesys_lock_acquire (void);
-void filesys_lock_release (void);
-
 #endif /* filesys/filesys.h */
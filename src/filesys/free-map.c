@@ -1,52 +1,126 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/synch.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+/* The free map is kept in memory and written back lazily.
+   Allocating or releasing sectors only updates the in-memory
+   bitmap and marks the sectors of the free map file that it
+   touched as dirty.  The dirty sectors, and only those, are
+   written to the file FLUSH_DELAY ticks after the first change,
+   so that a burst of changes costs one write per sector, and at
+   shutdown by free_map_close().  Writes go through the buffer
+   cache, which orders nothing between sectors; the free map
+   always reaches the cache before the file system is shut
+   down. */
+
+/* Ticks from the first change to the free map until it is
+   written back. */
+#define FLUSH_DELAY (TIMER_FREQ / 10)
+
+/* Bits of the free map in one sector of the free map file. */
+#define BITS_PER_SECTOR (BLOCK_SECTOR_SIZE * 8)
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct bitmap *dirty_map;     /* Free map file sectors to write. */
+static struct lock free_map_lock;    /* Protects the above two maps. */
+
+static struct lock flush_lock;       /* Serializes free_map_flush(). */
+static uint8_t flush_buf[BLOCK_SECTOR_SIZE]; /* Protected by flush_lock. */
+static struct work flush_work;       /* Delayed write-back. */
+
+static work_func flush_work_func;
+static void mark_dirty (block_sector_t, size_t cnt);
 
 /* Initializes the free map. */
 void
 free_map_init (void) 
 {
   free_map = bitmap_create (block_size (fs_device));
-  if (free_map == NULL)
+  dirty_map = bitmap_create (DIV_ROUND_UP (block_size (fs_device),
+                                           BITS_PER_SECTOR));
+  if (free_map == NULL || dirty_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  lock_init (&free_map_lock);
+  lock_init (&flush_lock);
+  work_init (&flush_work, flush_work_func, WORK_PRI_LOW);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
    the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
+   sectors were available. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
-    {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
-    }
+  block_sector_t sector;
+
+  lock_acquire (&free_map_lock);
+  sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  if (sector != BITMAP_ERROR)
+    mark_dirty (sector, cnt);
+  lock_release (&free_map_lock);
+
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
+/* Allocates as many consecutive sectors as possible, up to CNT,
+   and stores the first into *SECTORP.  Tries for all CNT first,
+   then for half as many, and so on, so that a fragmented disk
+   still yields the longest runs it can.  Returns the number of
+   sectors allocated, which is 0 if the disk is full. */
+size_t
+free_map_allocate_run (size_t cnt, block_sector_t *sectorp)
+{
+  for (; cnt > 0; cnt /= 2)
+    if (free_map_allocate (cnt, sectorp))
+      return cnt;
+  return 0;
+}
+
+/* Allocates up to CNT consecutive sectors starting exactly at
+   SECTOR, for extending a run that ends just before SECTOR.
+   Returns the number of sectors allocated, which is 0 if SECTOR
+   is in use. */
+size_t
+free_map_extend (block_sector_t sector, size_t cnt)
+{
+  size_t got = 0;
+
+  lock_acquire (&free_map_lock);
+  while (got < cnt && sector + got < bitmap_size (free_map)
+         && !bitmap_test (free_map, sector + got))
+    got++;
+  if (got > 0)
+    {
+      bitmap_set_multiple (free_map, sector, got, true);
+      mark_dirty (sector, got);
+    }
+  lock_release (&free_map_lock);
+
+  return got;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  mark_dirty (sector, cnt);
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -64,7 +138,12 @@ free_map_open (void)
 void
 free_map_close (void) 
 {
+  cancel_work (&flush_work);
+  free_map_flush ();
+  lock_acquire (&flush_lock);
   file_close (free_map_file);
+  free_map_file = NULL;
+  lock_release (&flush_lock);
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -80,6 +159,75 @@ free_map_create (void)
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
+  lock_acquire (&free_map_lock);
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+  bitmap_set_all (dirty_map, false);
+  lock_release (&free_map_lock);
+}
+
+/* Writes the sectors of the free map file that changed since
+   they were last written.  A sector that cannot be written is
+   marked dirty again, to be tried again later.
+
+   Each dirty sector is copied out, and its dirty bit cleared,
+   under free_map_lock, and then written with only flush_lock
+   held, so that allocation is not held up by the write and
+   free_map_lock is never held while taking inode or buffer cache
+   locks.  A change made during the write marks the sector dirty
+   again.  Holding flush_lock keeps concurrent flushes from
+   writing older copies of a sector over newer ones. */
+void
+free_map_flush (void)
+{
+  size_t i;
+
+  lock_acquire (&flush_lock);
+  for (i = 0; free_map_file != NULL && i < bitmap_size (dirty_map); i++)
+    {
+      off_t ofs = i * BLOCK_SECTOR_SIZE;
+      size_t size;
+
+      lock_acquire (&free_map_lock);
+      if (!bitmap_test (dirty_map, i))
+        {
+          lock_release (&free_map_lock);
+          continue;
+        }
+      size = bitmap_copy_part (free_map, flush_buf, ofs, BLOCK_SECTOR_SIZE);
+      bitmap_reset (dirty_map, i);
+      lock_release (&free_map_lock);
+
+      if (file_write_at (free_map_file, flush_buf, size, ofs) != (off_t) size)
+        {
+          lock_acquire (&free_map_lock);
+          bitmap_mark (dirty_map, i);
+          lock_release (&free_map_lock);
+        }
+    }
+  lock_release (&flush_lock);
+}
+
+/* Marks the free map file sectors that hold the bits for the CNT
+   sectors starting at SECTOR as dirty, and schedules a flush.
+   The caller must hold free_map_lock. */
+static void
+mark_dirty (block_sector_t sector, size_t cnt)
+{
+  size_t first = sector / BITS_PER_SECTOR;
+  size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+
+  ASSERT (lock_held_by_current_thread (&free_map_lock));
+  ASSERT (cnt > 0);
+
+  bitmap_set_multiple (dirty_map, first, last - first + 1, true);
+  if (free_map_file != NULL)
+    queue_delayed_work (&flush_work, FLUSH_DELAY);
+}
+
+/* Delayed write-back of the free map. */
+static void
+flush_work_func (struct work *w UNUSED)
+{
+  free_map_flush ();
 }
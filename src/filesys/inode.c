@@ -1,23 +1,79 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* A run of consecutive data sectors.  Only the first WRITTEN
+   sectors have ever been written.  The rest have never been
+   written, so they read as zeros without a trip to the disk, and
+   get no zeros written to them until they are written. */
+struct extent
+  {
+    block_sector_t start;               /* First sector. */
+    uint16_t length;                    /* Number of sectors. */
+    uint16_t written;                   /* Number of written sectors. */
+  };
+
+/* Most sectors in one extent. */
+#define MAX_EXTENT_LENGTH UINT16_MAX
+
+/* Number of extents held in the inode itself, and in its
+   indirect block. */
+#define DIRECT_EXTENT_CNT 61
+#define INDIRECT_EXTENT_CNT (BLOCK_SECTOR_SIZE / sizeof (struct extent))
+#define MAX_EXTENT_CNT (DIRECT_EXTENT_CNT + INDIRECT_EXTENT_CNT)
+
+/* Largest file whose data fits in the inode itself. */
+#define INLINE_MAX (DIRECT_EXTENT_CNT * sizeof (struct extent))
+
+/* Inode flags. */
+#define INODE_INLINE 0x1                /* Data is in the inode. */
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   A file's data sectors are a list of extents, the first
+   DIRECT_EXTENT_CNT in the inode and the rest in a single
+   indirect block.  A file grows by extending its last extent if
+   the sectors after it are free, otherwise by adding the longest
+   extent the free map can supply, so files stay mostly
+   contiguous but can still be allocated on a fragmented disk.
+   Newly allocated sectors are not zeroed; instead, each extent
+   records how many of its sectors have been written.  A write
+   past that point splits the extent, so that the sectors it
+   skips stay unwritten, and extents are merged back together as
+   they fill up.  Exactly bytes_to_sectors(length) sectors are
+   allocated: a write that cannot grow the file as far as it
+   wants gives back the sectors it got but did not fill.
+
+   A file of at most INLINE_MAX bytes is instead kept in the
+   inode, in place of the extents, with INODE_INLINE set in
+   `flags'.  It has no data sectors at all.  Its data moves out
+   to data sectors when it grows past INLINE_MAX bytes. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t sector_cnt;                /* Number of data sectors. */
+    uint32_t extent_cnt;                /* Number of extents. */
+    block_sector_t indirect;            /* Sector of further extents,
+                                           or 0 if there are none. */
+    union
+      {
+        struct extent extents[DIRECT_EXTENT_CNT]; /* First extents. */
+        uint8_t data[INLINE_MAX];       /* Data, if INODE_INLINE. */
+      };
+    uint32_t flags;                     /* INODE_* flags. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -28,40 +84,105 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
-/* In-memory inode. */
+/* In-memory inode.
+
+   `rw' guards the inode's data, DATA, and DENY_WRITE_CNT.  Reads
+   hold it as readers, so that any number of them can read the
+   same file at once, while writes, which may grow the file and
+   rewrite DATA, hold it as writers.  DIR_LOCK is not used by the
+   inode code: it guards the contents of a directory as a whole,
+   across the several reads and writes that make up one directory
+   operation.  A thread that holds DIR_LOCK may go on to take `rw'
+   of the same inode, but not the other way around. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct rwlock rw;                   /* Guards data and deny_write_cnt. */
+    struct rwlock dir_lock;             /* Guards directory contents. */
     struct inode_disk data;             /* Inode content. */
   };
 
-/* Returns the block device sector that contains byte offset POS
-   within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
-static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+/* The location of a data sector among an inode's extents. */
+struct extent_pos
+  {
+    size_t idx;                         /* Extent number. */
+    struct extent e;                    /* Copy of the extent. */
+    size_t ofs;                         /* Sector's offset in extent. */
+  };
+
+static void get_extent (const struct inode_disk *, size_t idx,
+                        struct extent *);
+static void set_extent (struct inode_disk *, size_t idx,
+                        const struct extent *);
+static bool make_room (struct inode_disk *);
+static void insert_extent (struct inode_disk *, size_t idx,
+                           const struct extent *);
+static void remove_extent (struct inode_disk *, size_t idx);
+static void try_merge (struct inode_disk *, size_t idx);
+static block_sector_t mark_written (struct inode_disk *, struct extent_pos *);
+static bool extend (struct inode_disk *, size_t sector_cnt);
+static void trim (struct inode_disk *, size_t sector_cnt);
+static void release_sectors (struct inode_disk *);
+static void zero_sectors (block_sector_t, size_t cnt);
+static bool move_out_inline (struct inode *);
+static off_t read_at (struct inode *, void *, off_t size, off_t offset);
+static off_t write_at (struct inode *, const void *, off_t size,
+                       off_t offset);
+
+/* Returns true if DISK's data is kept in DISK itself. */
+static inline bool
+is_inline (const struct inode_disk *disk)
 {
-  ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
-    return -1;
+  return (disk->flags & INODE_INLINE) != 0;
+}
+
+/* Finds the data sector that contains byte offset POS within
+   DISK and stores its location into *P.  Returns false if DISK
+   has no sector allocated for offset POS. */
+static bool
+find_sector (const struct inode_disk *disk, off_t pos, struct extent_pos *p)
+{
+  size_t sector_ofs;
+
+  if (pos < 0 || (size_t) pos / BLOCK_SECTOR_SIZE >= disk->sector_cnt)
+    return false;
+
+  sector_ofs = pos / BLOCK_SECTOR_SIZE;
+  for (p->idx = 0; p->idx < disk->extent_cnt; p->idx++)
+    {
+      get_extent (disk, p->idx, &p->e);
+      if (sector_ofs < p->e.length)
+        {
+          p->ofs = sector_ofs;
+          return true;
+        }
+      sector_ofs -= p->e.length;
+    }
+  NOT_REACHED ();
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Open inodes, hashed by sector, so that opening a single inode
+   twice returns the same `struct inode'. */
+static struct hash open_inodes;
+
+/* Protects open_inodes and each open inode's open_cnt. */
+static struct lock open_inodes_lock;
+
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
+static struct inode *lookup_open (block_sector_t);
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+    PANIC ("can't create open inode table");
+  lock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -84,22 +205,23 @@ inode_create (block_sector_t sector, off_t length)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      if (length <= (off_t) INLINE_MAX)
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
+          /* Small enough to keep in the inode.  The data starts
+             out zeroed by calloc(). */
+          disk_inode->flags = INODE_INLINE;
+          cache_write (sector, disk_inode);
+          success = true;
+        }
+      else if (extend (disk_inode, bytes_to_sectors (length))) 
+        {
+          cache_write (sector, disk_inode);
           success = true; 
         } 
+      else
+        release_sectors (disk_inode);
       free (disk_inode);
     }
   return success;
@@ -111,33 +233,46 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
-  struct inode *inode;
+  struct inode *inode, *other;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  lock_acquire (&open_inodes_lock);
+  inode = lookup_open (sector);
+  if (inode != NULL)
+    inode->open_cnt++;
+  lock_release (&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
     return NULL;
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize, reading the disk inode without holding
+     open_inodes_lock. */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  rwlock_init (&inode->rw);
+  rwlock_init (&inode->dir_lock);
+  cache_read (inode->sector, &inode->data);
+
+  /* Another thread may have opened the inode meanwhile.  If so,
+     use its copy instead. */
+  lock_acquire (&open_inodes_lock);
+  other = lookup_open (sector);
+  if (other != NULL)
+    other->open_cnt++;
+  else
+    hash_insert (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+  if (other != NULL)
+    {
+      free (inode);
+      return other;
+    }
   return inode;
 }
 
@@ -146,7 +281,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -163,22 +302,28 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  /* Release resources if this was the last opener.  Once INODE
+     is out of open_inodes, no other thread can find it, so the
+     rest needs no lock. */
+  lock_acquire (&open_inodes_lock);
+  last = --inode->open_cnt == 0;
+  if (last)
+    hash_delete (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          release_sectors (&inode->data);
         }
 
       free (inode); 
@@ -191,23 +336,49 @@ void
 inode_remove (struct inode *inode) 
 {
   ASSERT (inode != NULL);
+
+  lock_acquire (&open_inodes_lock);
   inode->removed = true;
+  lock_release (&open_inodes_lock);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) 
+{
+  off_t bytes_read;
+
+  rwlock_read_acquire (&inode->rw);
+  bytes_read = read_at (inode, buffer, size, offset);
+  rwlock_read_release (&inode->rw);
+
+  return bytes_read;
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position
+   OFFSET, for inode_read_at().  The caller must hold INODE's
+   `rw' lock. */
+static off_t
+read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+
+  if (is_inline (&inode->data))
+    {
+      if (offset >= inode_length (inode) || size <= 0)
+        return 0;
+      if (size > inode_length (inode) - offset)
+        size = inode_length (inode) - offset;
+      memcpy (buffer, inode->data.data + offset, size);
+      return size;
+    }
 
   while (size > 0) 
     {
-      /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      /* Starting byte offset within sector to read. */
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -217,102 +388,159 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 
       /* Number of bytes to actually copy out of this sector. */
       int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
+      struct extent_pos p;
+      if (chunk_size <= 0 || !find_sector (&inode->data, offset, &p))
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      /* A sector never written holds zeros. */
+      if (p.ofs < p.e.written)
+        cache_read_at (p.e.start + p.ofs, buffer + bytes_read,
+                       sector_ofs, chunk_size);
+      else
+        memset (buffer + bytes_read, 0, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
 
   return bytes_read;
 }
 
+/* Starts reading the SIZE bytes of INODE at OFFSET into the
+   buffer cache in the background, so that a later
+   inode_read_at() finds them there.  Bytes past end of file are
+   ignored. */
+void
+inode_readahead (struct inode *inode, off_t size, off_t offset)
+{
+  off_t end = offset + size;
+
+  rwlock_read_acquire (&inode->rw);
+  if (end > inode_length (inode))
+    end = inode_length (inode);
+  offset = ROUND_DOWN (offset, BLOCK_SECTOR_SIZE);
+  for (; offset < end && !is_inline (&inode->data);
+       offset += BLOCK_SECTOR_SIZE)
+    {
+      struct extent_pos p;
+
+      if (find_sector (&inode->data, offset, &p) && p.ofs < p.e.written)
+        cache_prefetch (p.e.start + p.ofs);
+    }
+  rwlock_read_release (&inode->rw);
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up or an error occurs.
+   Writing past end of file extends the file, and any gap
+   between the old end of file and OFFSET reads as zeros. */
 off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
                 off_t offset) 
 {
+  off_t bytes_written;
+
+  rwlock_write_acquire (&inode->rw);
+  bytes_written = write_at (inode, buffer, size, offset);
+  rwlock_write_release (&inode->rw);
+
+  return bytes_written;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+   for inode_write_at().  The caller must hold INODE's `rw' lock
+   as a writer. */
+static off_t
+write_at (struct inode *inode, const void *buffer_, off_t size,
+          off_t offset) 
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  size_t old_sector_cnt = inode->data.sector_cnt;
+  bool dirty = false;
 
-  if (inode->deny_write_cnt)
+  if (inode->deny_write_cnt || size <= 0)
     return 0;
 
+  if (is_inline (&inode->data))
+    {
+      /* Write inline data in place, if it still fits. */
+      if (offset + size <= (off_t) INLINE_MAX)
+        {
+          memcpy (inode->data.data + offset, buffer, size);
+          if (offset + size > inode->data.length)
+            inode->data.length = offset + size;
+          cache_write (inode->sector, &inode->data);
+          return size;
+        }
+      if (!move_out_inline (inode))
+        return 0;
+    }
+
+  /* Allocate sectors for the part past end of file, as many as
+     the disk allows. */
+  if (offset + size > (off_t) inode->data.sector_cnt * BLOCK_SECTOR_SIZE)
+    {
+      extend (&inode->data, bytes_to_sectors (offset + size));
+      dirty = true;
+    }
+
   while (size > 0) 
     {
-      /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      /* Starting byte offset within sector to write. */
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      /* Bytes left in allocated sectors, bytes left in sector,
+         lesser of the two. */
+      off_t inode_left = (off_t) inode->data.sector_cnt * BLOCK_SECTOR_SIZE
+                         - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
       /* Number of bytes to actually write into this sector. */
       int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
+      struct extent_pos p;
+      block_sector_t sector_idx;
+      if (chunk_size <= 0 || !find_sector (&inode->data, offset, &p))
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
+      sector_idx = p.e.start + p.ofs;
+      if (p.ofs >= p.e.written)
         {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
+          /* First write to this sector.  Its old contents on disk
+             are garbage, so start a partial write from zeros. */
+          sector_idx = mark_written (&inode->data, &p);
+          if (chunk_size < BLOCK_SECTOR_SIZE)
+            cache_write (sector_idx, zeros);
+          dirty = true;
         }
+      cache_write_at (sector_idx, buffer + bytes_written, sector_ofs,
+                      chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
+
+  /* Extend the file over the data written, if any, and give back
+     any sectors allocated above that were not reached. */
+  if (bytes_written > 0 && offset > inode->data.length)
+    {
+      inode->data.length = offset;
+      dirty = true;
+    }
+  if (inode->data.sector_cnt > old_sector_cnt)
+    {
+      size_t needed = bytes_to_sectors (inode->data.length);
+      trim (&inode->data, needed > old_sector_cnt ? needed : old_sector_cnt);
+    }
+  if (dirty)
+    cache_write (inode->sector, &inode->data);
 
   return bytes_written;
 }
@@ -322,8 +550,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 void
 inode_deny_write (struct inode *inode) 
 {
+  rwlock_write_acquire (&inode->rw);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  rwlock_write_release (&inode->rw);
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +562,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  rwlock_write_acquire (&inode->rw);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  rwlock_write_release (&inode->rw);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -343,3 +575,332 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Returns the lock that guards the contents of directory INODE
+   across a whole directory operation.  Lookups should hold it as
+   readers, changes as writers. */
+struct rwlock *
+inode_dir_lock (struct inode *inode)
+{
+  return &inode->dir_lock;
+}
+
+/* Returns a hash value for the inode that contains E. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+/* Returns true if the inode that contains A precedes the one that
+   contains B. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
+}
+
+/* Returns the open inode for SECTOR, or a null pointer if SECTOR
+   is not open.  The caller must hold open_inodes_lock. */
+static struct inode *
+lookup_open (block_sector_t sector)
+{
+  struct inode key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&open_inodes_lock));
+
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  return e != NULL ? hash_entry (e, struct inode, elem) : NULL;
+}
+
+/* Stores extent number IDX of DISK into *E. */
+static void
+get_extent (const struct inode_disk *disk, size_t idx, struct extent *e)
+{
+  ASSERT (idx < disk->extent_cnt);
+
+  if (idx < DIRECT_EXTENT_CNT)
+    *e = disk->extents[idx];
+  else
+    cache_read_at (disk->indirect, e,
+                   (idx - DIRECT_EXTENT_CNT) * sizeof *e, sizeof *e);
+}
+
+/* Sets extent number IDX of DISK to E.  DISK must already have an
+   indirect block if IDX is not one of the direct extents. */
+static void
+set_extent (struct inode_disk *disk, size_t idx, const struct extent *e)
+{
+  ASSERT (idx < MAX_EXTENT_CNT);
+
+  if (idx < DIRECT_EXTENT_CNT)
+    disk->extents[idx] = *e;
+  else
+    cache_write_at (disk->indirect, e,
+                    (idx - DIRECT_EXTENT_CNT) * sizeof *e, sizeof *e);
+}
+
+/* Makes room in DISK for one more extent, allocating its indirect
+   block if need be.  Returns true if successful, false if DISK
+   has as many extents as it can hold or the disk is full. */
+static bool
+make_room (struct inode_disk *disk)
+{
+  if (disk->extent_cnt == MAX_EXTENT_CNT)
+    return false;
+  if (disk->extent_cnt == DIRECT_EXTENT_CNT && disk->indirect == 0)
+    return free_map_allocate (1, &disk->indirect);
+  return true;
+}
+
+/* Inserts E into DISK as extent number IDX, after making room for
+   it with make_room(). */
+static void
+insert_extent (struct inode_disk *disk, size_t idx, const struct extent *e)
+{
+  size_t i;
+
+  ASSERT (idx <= disk->extent_cnt);
+
+  for (i = disk->extent_cnt++; i > idx; i--)
+    {
+      struct extent prev;
+      get_extent (disk, i - 1, &prev);
+      set_extent (disk, i, &prev);
+    }
+  set_extent (disk, idx, e);
+}
+
+/* Removes extent number IDX from DISK. */
+static void
+remove_extent (struct inode_disk *disk, size_t idx)
+{
+  size_t i;
+
+  ASSERT (idx < disk->extent_cnt);
+
+  for (i = idx + 1; i < disk->extent_cnt; i++)
+    {
+      struct extent next;
+      get_extent (disk, i, &next);
+      set_extent (disk, i - 1, &next);
+    }
+  disk->extent_cnt--;
+}
+
+/* Merges extent number IDX of DISK with the next one, if IDX is
+   wholly written and the next one continues it on disk. */
+static void
+try_merge (struct inode_disk *disk, size_t idx)
+{
+  struct extent a, b;
+
+  if (idx + 1 >= disk->extent_cnt)
+    return;
+  get_extent (disk, idx, &a);
+  get_extent (disk, idx + 1, &b);
+  if (a.written == a.length && a.start + a.length == b.start
+      && a.length + b.length <= MAX_EXTENT_LENGTH)
+    {
+      a.written += b.written;
+      a.length += b.length;
+      set_extent (disk, idx, &a);
+      remove_extent (disk, idx + 1);
+    }
+}
+
+/* Records in DISK that the never-written sector at *P is about
+   to be written, and returns the sector.  Invalidates *P.
+
+   If the sector is past the start of the unwritten part of its
+   extent, splits the extent there, so that the sectors skipped
+   stay unwritten.  If there is no room for another extent, zeros
+   the skipped sectors instead. */
+static block_sector_t
+mark_written (struct inode_disk *disk, struct extent_pos *p)
+{
+  block_sector_t sector = p->e.start + p->ofs;
+
+  ASSERT (p->ofs >= p->e.written);
+
+  if (p->ofs > p->e.written)
+    {
+      if (make_room (disk))
+        {
+          struct extent tail;
+
+          tail.start = sector;
+          tail.length = p->e.length - p->ofs;
+          tail.written = 0;
+          p->e.length = p->ofs;
+          set_extent (disk, p->idx, &p->e);
+          insert_extent (disk, ++p->idx, &tail);
+          p->e = tail;
+          p->ofs = 0;
+        }
+      else
+        {
+          zero_sectors (p->e.start + p->e.written, p->ofs - p->e.written);
+          p->e.written = p->ofs;
+        }
+    }
+
+  p->e.written++;
+  set_extent (disk, p->idx, &p->e);
+  try_merge (disk, p->idx);
+  if (p->idx > 0)
+    try_merge (disk, p->idx - 1);
+  return sector;
+}
+
+/* Allocates data sectors for DISK, as yet unwritten, until it has
+   SECTOR_CNT of them, extending its last extent where possible.  Returns
+   true if successful, false if the disk or DISK's extent list
+   fills up first, in which case DISK keeps the sectors it got.
+   The caller must write DISK back to disk. */
+static bool
+extend (struct inode_disk *disk, size_t sector_cnt)
+{
+  while (disk->sector_cnt < sector_cnt)
+    {
+      size_t want = sector_cnt - disk->sector_cnt;
+      struct extent e;
+
+      /* Try to continue the last extent. */
+      if (disk->extent_cnt > 0)
+        {
+          size_t room, got = 0;
+
+          get_extent (disk, disk->extent_cnt - 1, &e);
+          room = MAX_EXTENT_LENGTH - e.length;
+          if (room > 0)
+            got = free_map_extend (e.start + e.length,
+                                   want < room ? want : room);
+          if (got > 0)
+            {
+              e.length += got;
+              set_extent (disk, disk->extent_cnt - 1, &e);
+              disk->sector_cnt += got;
+              continue;
+            }
+        }
+
+      /* Otherwise start a new one. */
+      if (!make_room (disk))
+        return false;
+      e.length = free_map_allocate_run (want < (size_t) MAX_EXTENT_LENGTH
+                                        ? want : (size_t) MAX_EXTENT_LENGTH,
+                                        &e.start);
+      e.written = 0;
+      if (e.length == 0)
+        return false;
+      insert_extent (disk, disk->extent_cnt, &e);
+      disk->sector_cnt += e.length;
+    }
+  return true;
+}
+
+/* Releases DISK's data sectors past the first SECTOR_CNT, taking
+   them off the end of its extents.  Unused extent slots in the
+   indirect block are kept, along with the block itself. */
+static void
+trim (struct inode_disk *disk, size_t sector_cnt)
+{
+  while (disk->sector_cnt > sector_cnt)
+    {
+      size_t excess = disk->sector_cnt - sector_cnt;
+      size_t idx = disk->extent_cnt - 1;
+      struct extent e;
+
+      get_extent (disk, idx, &e);
+      if (e.length <= excess)
+        {
+          free_map_release (e.start, e.length);
+          disk->sector_cnt -= e.length;
+          remove_extent (disk, idx);
+        }
+      else
+        {
+          e.length -= excess;
+          if (e.written > e.length)
+            e.written = e.length;
+          free_map_release (e.start + e.length, excess);
+          set_extent (disk, idx, &e);
+          disk->sector_cnt -= excess;
+        }
+    }
+}
+
+/* Releases all of DISK's data sectors, and its indirect block. */
+static void
+release_sectors (struct inode_disk *disk)
+{
+  size_t i;
+
+  for (i = 0; i < disk->extent_cnt; i++)
+    {
+      struct extent e;
+
+      get_extent (disk, i, &e);
+      free_map_release (e.start, e.length);
+    }
+  if (disk->indirect != 0)
+    free_map_release (disk->indirect, 1);
+  disk->extent_cnt = disk->sector_cnt = 0;
+  disk->indirect = 0;
+}
+
+/* Fills the CNT sectors starting at SECTOR with zeros. */
+static void
+zero_sectors (block_sector_t sector, size_t cnt)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  for (; cnt > 0; cnt--)
+    cache_write (sector++, zeros);
+}
+
+/* Moves the data of inline INODE out of the inode, into data
+   sectors, so that it can grow past INLINE_MAX bytes.  Returns
+   true if successful, false if memory or disk allocation fails,
+   in which case INODE is left unchanged. */
+static bool
+move_out_inline (struct inode *inode)
+{
+  struct inode_disk *disk = &inode->data;
+  off_t length = disk->length;
+  uint8_t *copy;
+
+  ASSERT (rwlock_write_held_by_current_thread (&inode->rw));
+  ASSERT (is_inline (disk));
+  ASSERT (disk->sector_cnt == 0 && disk->extent_cnt == 0);
+
+  copy = malloc (INLINE_MAX);
+  if (copy == NULL)
+    return false;
+  memcpy (copy, disk->data, INLINE_MAX);
+
+  /* Turn INODE into an empty regular file and write the data
+     back to it.  Bytes past LENGTH are all zeros, so only LENGTH
+     bytes need writing. */
+  memset (disk->extents, 0, sizeof disk->extents);
+  disk->flags &= ~INODE_INLINE;
+  disk->length = 0;
+  if (length > 0 && write_at (inode, copy, length, 0) != length)
+    {
+      release_sectors (disk);
+      memcpy (disk->data, copy, INLINE_MAX);
+      disk->flags |= INODE_INLINE;
+      disk->length = length;
+      cache_write (inode->sector, disk);
+      free (copy);
+      return false;
+    }
+
+  free (copy);
+  return true;
+}
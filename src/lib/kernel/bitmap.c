@@ -3,6 +3,7 @@
 #include <limits.h>
 #include <round.h>
 #include <stdio.h>
+#include <string.h>
 #include "threads/malloc.h"
 #ifdef FILESYS
 #include "filesys/file.h"
@@ -359,6 +360,22 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Copies the SIZE bytes at byte offset OFS in B's file image, as
+   written by bitmap_write(), into DST, so that the caller can
+   write them to the same offset in a file.  Bytes past the end
+   of B are not copied.  Returns the number of bytes copied. */
+size_t
+bitmap_copy_part (const struct bitmap *b, void *dst, size_t ofs, size_t size)
+{
+  size_t total = byte_cnt (b->bit_cnt);
+  if (ofs >= total)
+    return 0;
+  if (size > total - ofs)
+    size = total - ofs;
+  memcpy (dst, (const char *) b->bits + ofs, size);
+  return size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -0,0 +1,188 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* A pairing heap is a tree in which every node is greater than
+   or equal to its children.  Each node points to its first
+   child, and the children of a node form a doubly linked list
+   through their `next' and `prev' members, except that the first
+   child's `prev' points to the parent.  The root has no
+   siblings.
+
+   Two heaps are melded by making the root with the lesser value
+   the first child of the other.  Popping the root melds its
+   children in pairs from left to right, then melds the pairs
+   together from right to left; this two-pass scheme is what
+   gives the amortized O(log n) bound. */
+
+static struct heap_elem *meld (struct heap *, struct heap_elem *,
+                               struct heap_elem *);
+static struct heap_elem *meld_children (struct heap *,
+                                        struct heap_elem *first);
+static void detach (struct heap_elem *);
+
+/* Initializes HEAP as an empty heap ordered by LESS given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux)
+{
+  ASSERT (heap != NULL);
+  ASSERT (less != NULL);
+
+  heap->root = NULL;
+  heap->less = less;
+  heap->aux = aux;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (const struct heap *heap)
+{
+  return heap->root == NULL;
+}
+
+/* Returns the greatest element in HEAP, which must not be
+   empty.  If there is more than one, returns any of them. */
+struct heap_elem *
+heap_max (const struct heap *heap)
+{
+  ASSERT (!heap_empty (heap));
+  return heap->root;
+}
+
+/* Inserts ELEM, which must not be in any heap, into HEAP. */
+void
+heap_insert (struct heap *heap, struct heap_elem *elem)
+{
+  ASSERT (elem != NULL);
+
+  elem->child = elem->next = elem->prev = NULL;
+  heap->root = meld (heap, heap->root, elem);
+}
+
+/* Removes and returns the greatest element of HEAP, which must
+   not be empty. */
+struct heap_elem *
+heap_pop_max (struct heap *heap)
+{
+  struct heap_elem *max = heap_max (heap);
+
+  heap->root = meld_children (heap, max->child);
+  max->child = NULL;
+  return max;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem)
+{
+  ASSERT (elem != NULL);
+
+  if (elem == heap->root)
+    heap_pop_max (heap);
+  else
+    {
+      detach (elem);
+      heap->root = meld (heap, heap->root,
+                         meld_children (heap, elem->child));
+      elem->child = NULL;
+    }
+}
+
+/* Restores the order of HEAP after the value of ELEM, which must
+   be in HEAP, has increased (or stayed the same). */
+void
+heap_increased (struct heap *heap, struct heap_elem *elem)
+{
+  ASSERT (elem != NULL);
+
+  if (elem != heap->root)
+    {
+      /* ELEM's subtree is still in order, so cut it out and meld
+         it back in at the root. */
+      detach (elem);
+      heap->root = meld (heap, heap->root, elem);
+    }
+}
+
+/* Melds the heaps rooted at A and B, which may be null, and
+   returns the root of the result. */
+static struct heap_elem *
+meld (struct heap *heap, struct heap_elem *a, struct heap_elem *b)
+{
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+
+  if (heap->less (a, b, heap->aux))
+    {
+      struct heap_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  /* Make B the first child of A. */
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  a->next = a->prev = NULL;
+  return a;
+}
+
+/* Melds the list of sibling heaps starting at FIRST into one,
+   in two passes, and returns its root. */
+static struct heap_elem *
+meld_children (struct heap *heap, struct heap_elem *first)
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root = NULL;
+
+  /* First pass: meld siblings in pairs, left to right, stacking
+     the results through their `next' members. */
+  while (first != NULL)
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+      struct heap_elem *pair;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL)
+        b->next = b->prev = NULL;
+
+      pair = meld (heap, a, b);
+      pair->next = pairs;
+      pairs = pair;
+    }
+
+  /* Second pass: meld the pairs right to left. */
+  while (pairs != NULL)
+    {
+      struct heap_elem *pair = pairs;
+      pairs = pair->next;
+      pair->next = NULL;
+      root = meld (heap, root, pair);
+    }
+
+  if (root != NULL)
+    root->next = root->prev = NULL;
+  return root;
+}
+
+/* Unlinks non-root ELEM, with its subtree, from its parent and
+   siblings. */
+static void
+detach (struct heap_elem *elem)
+{
+  ASSERT (elem->prev != NULL);
+
+  if (elem->prev->child == elem)
+    elem->prev->child = elem->next;
+  else
+    elem->prev->next = elem->next;
+  if (elem->next != NULL)
+    elem->next->prev = elem->prev;
+  elem->next = elem->prev = NULL;
+}
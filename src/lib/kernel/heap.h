@@ -0,0 +1,64 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Max-heap.
+
+   This is a pairing heap.  Like our lists and hash tables, it
+   does not allocate memory: each structure that is a potential
+   heap element must embed a struct heap_elem member, and the
+   heap_entry macro converts from a struct heap_elem back to the
+   structure that contains it.  The order of elements is given by
+   a heap_less_func supplied to heap_init().
+
+   heap_insert() and heap_max() take constant time.
+   heap_pop_max() and heap_remove() take amortized O(log n) time.
+   If an element's key increases while it is in a heap, calling
+   heap_increased() restores the heap order in constant time.
+   Decreasing a key in place is not supported; remove the element
+   and insert it again instead. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem
+  {
+    struct heap_elem *child;    /* First child. */
+    struct heap_elem *next;     /* Next sibling. */
+    struct heap_elem *prev;     /* Previous sibling, or parent if
+                                   this is the first child. */
+  };
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)           \
+        ((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->child    \
+                     - offsetof (STRUCT, MEMBER.child)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Heap. */
+struct heap
+  {
+    struct heap_elem *root;     /* Greatest element, or null. */
+    heap_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+bool heap_empty (const struct heap *);
+struct heap_elem *heap_max (const struct heap *);
+void heap_insert (struct heap *, struct heap_elem *);
+struct heap_elem *heap_pop_max (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+void heap_increased (struct heap *, struct heap_elem *);
+
+#endif /* lib/kernel/heap.h */
@@ -0,0 +1,56 @@
+/* Grows a file by writing every other sector, leaving a hole
+   before each one.  Every sector written that way starts a new
+   extent, so the file ends up with more extents than fit in its
+   inode and has to spill into its indirect extent block.  Then
+   fills in the holes, merging the extents back together, and
+   verifies the file at both points. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_SIZE 512
+#define WRITE_CNT 100           /* Well over the 61 extents in an inode. */
+#define FILE_SIZE ((2 * WRITE_CNT - 1) * BLOCK_SIZE)
+
+static char buf[FILE_SIZE];
+static char expected[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_name = "sieve";
+  size_t ofs;
+  int fd;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  msg ("write every other sector of \"%s\"", file_name);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += 2 * BLOCK_SIZE)
+    {
+      seek (fd, ofs);
+      if (write (fd, buf + ofs, BLOCK_SIZE) != BLOCK_SIZE)
+        fail ("write %d bytes at offset %zu failed", BLOCK_SIZE, ofs);
+      memcpy (expected + ofs, buf + ofs, BLOCK_SIZE);
+    }
+  check_file (file_name, expected, FILE_SIZE);
+
+  msg ("fill in the other sectors of \"%s\"", file_name);
+  for (ofs = BLOCK_SIZE; ofs < FILE_SIZE; ofs += 2 * BLOCK_SIZE)
+    {
+      seek (fd, ofs);
+      if (write (fd, buf + ofs, BLOCK_SIZE) != BLOCK_SIZE)
+        fail ("write %d bytes at offset %zu failed", BLOCK_SIZE, ofs);
+    }
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  check_file (file_name, buf, FILE_SIZE);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-indirect) begin
+(grow-indirect) create "sieve"
+(grow-indirect) open "sieve"
+(grow-indirect) write every other sector of "sieve"
+(grow-indirect) open "sieve" for verification
+(grow-indirect) verified contents of "sieve"
+(grow-indirect) close "sieve"
+(grow-indirect) fill in the other sectors of "sieve"
+(grow-indirect) close "sieve"
+(grow-indirect) open "sieve" for verification
+(grow-indirect) verified contents of "sieve"
+(grow-indirect) close "sieve"
+(grow-indirect) end
+EOF
+pass;
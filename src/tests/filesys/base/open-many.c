@@ -0,0 +1,54 @@
+/* Creates many files, keeps them all open, and then opens and
+   closes each of them again, many times over.  This is a
+   benchmark for looking up already open inodes: each reopen has
+   to find the file's inode among all the others. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 100
+#define ROUND_CNT 20
+
+static int fds[FILE_CNT];
+
+void
+test_main (void) 
+{
+  char file_name[16];
+  int i, round;
+
+  msg ("creating and opening %d files", FILE_CNT);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (file_name, sizeof file_name, "file%d", i);
+      CHECK (create (file_name, 0), "create \"%s\"", file_name);
+      CHECK ((fds[i] = open (file_name)) > 1, "open \"%s\"", file_name);
+    }
+  quiet = false;
+
+  msg ("reopening each file %d times", ROUND_CNT);
+  quiet = true;
+  for (round = 0; round < ROUND_CNT; round++)
+    for (i = 0; i < FILE_CNT; i++)
+      {
+        int fd;
+
+        snprintf (file_name, sizeof file_name, "file%d", i);
+        CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+        close (fd);
+      }
+  quiet = false;
+
+  msg ("closing and removing %d files", FILE_CNT);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (file_name, sizeof file_name, "file%d", i);
+      close (fds[i]);
+      CHECK (remove (file_name), "remove \"%s\"", file_name);
+    }
+  quiet = false;
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(open-many) begin
+(open-many) creating and opening 100 files
+(open-many) reopening each file 20 times
+(open-many) closing and removing 100 files
+(open-many) end
+EOF
+pass;
@@ -0,0 +1,51 @@
+/* Writes a little data at the start of an empty file, then more
+   well past its end, and verifies that the gap in between reads
+   back as zeros.  The gap spans several whole sectors, which are
+   allocated but never written. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define HEAD_SIZE 100
+#define TAIL_OFS 5000
+#define TAIL_SIZE 100
+#define FILE_SIZE (TAIL_OFS + TAIL_SIZE)
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_name = "gappy";
+  char byte;
+  int fd;
+
+  random_init (0);
+  random_bytes (buf, HEAD_SIZE);
+  random_bytes (buf + TAIL_OFS, TAIL_SIZE);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  msg ("write %d bytes at offset 0", HEAD_SIZE);
+  if (write (fd, buf, HEAD_SIZE) != HEAD_SIZE)
+    fail ("write %d bytes at offset 0 failed", HEAD_SIZE);
+
+  msg ("write %d bytes at offset %d", TAIL_SIZE, TAIL_OFS);
+  seek (fd, TAIL_OFS);
+  if (write (fd, buf + TAIL_OFS, TAIL_SIZE) != TAIL_SIZE)
+    fail ("write %d bytes at offset %d failed", TAIL_SIZE, TAIL_OFS);
+
+  msg ("read past end of file");
+  seek (fd, FILE_SIZE + 1000);
+  if (read (fd, &byte, 1) != 0)
+    fail ("read past end of file returned data");
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  check_file (file_name, buf, FILE_SIZE);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sparse-gap) begin
+(sparse-gap) create "gappy"
+(sparse-gap) open "gappy"
+(sparse-gap) write 100 bytes at offset 0
+(sparse-gap) write 100 bytes at offset 5000
+(sparse-gap) read past end of file
+(sparse-gap) close "gappy"
+(sparse-gap) open "gappy" for verification
+(sparse-gap) verified contents of "gappy"
+(sparse-gap) close "gappy"
+(sparse-gap) end
+EOF
+pass;
@@ -0,0 +1,71 @@
+/* Writes the sectors of a file one at a time, in an order that
+   jumps back and forth, starting from an empty file.  Each jump
+   forward leaves a run of unwritten sectors that splits the
+   file's extents, and filling those runs in later lets the
+   extents merge back together.  The file is verified halfway
+   through, when it still has holes that must read as zeros, and
+   again at the end. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_SIZE 512
+#define BLOCK_CNT 64
+#define STRIDE 37               /* Relatively prime to BLOCK_CNT. */
+
+static char buf[BLOCK_SIZE * BLOCK_CNT];
+static char expected[BLOCK_SIZE * BLOCK_CNT];
+
+/* Writes the blocks numbered I * STRIDE % BLOCK_CNT for I from
+   FIRST up to but not including LAST to FD, copying each one to
+   EXPECTED too.  Returns the file size afterward, given that it
+   was SIZE before. */
+static size_t
+write_blocks (int fd, int first, int last, size_t size)
+{
+  int i;
+
+  for (i = first; i < last; i++)
+    {
+      size_t ofs = (size_t) (i * STRIDE % BLOCK_CNT) * BLOCK_SIZE;
+
+      seek (fd, ofs);
+      if (write (fd, buf + ofs, BLOCK_SIZE) != BLOCK_SIZE)
+        fail ("write %d bytes at offset %zu failed", BLOCK_SIZE, ofs);
+      memcpy (expected + ofs, buf + ofs, BLOCK_SIZE);
+      if (ofs + BLOCK_SIZE > size)
+        size = ofs + BLOCK_SIZE;
+    }
+  return size;
+}
+
+void
+test_main (void) 
+{
+  const char *file_name = "holes";
+  size_t size;
+  int fd;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  msg ("write half of \"%s\" out of order", file_name);
+  size = write_blocks (fd, 0, BLOCK_CNT / 2, 0);
+  check_file (file_name, expected, size);
+
+  msg ("write rest of \"%s\" out of order", file_name);
+  size = write_blocks (fd, BLOCK_CNT / 2, BLOCK_CNT, size);
+  if (size != sizeof buf)
+    fail ("file should be %zu bytes, not %zu", sizeof buf, size);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  check_file (file_name, buf, sizeof buf);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sparse-merge) begin
+(sparse-merge) create "holes"
+(sparse-merge) open "holes"
+(sparse-merge) write half of "holes" out of order
+(sparse-merge) open "holes" for verification
+(sparse-merge) verified contents of "holes"
+(sparse-merge) close "holes"
+(sparse-merge) write rest of "holes" out of order
+(sparse-merge) close "holes"
+(sparse-merge) open "holes" for verification
+(sparse-merge) verified contents of "holes"
+(sparse-merge) close "holes"
+(sparse-merge) end
+EOF
+pass;
@@ -0,0 +1,69 @@
+/* The main thread acquires a reader-writer lock for reading.  A
+   second reader gets the lock alongside it, but a writer must
+   wait until main releases it.  A reader that arrives while the
+   writer waits must wait for the writer, even though it has
+   higher priority. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+static thread_func late_reader_thread_func;
+
+void
+test_synch_rwlock (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_read_acquire (&rw);
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread_func, &rw, NULL);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rw, NULL);
+  thread_create ("late reader", PRI_DEFAULT + 2, late_reader_thread_func,
+                 &rw, NULL);
+  msg ("main: releasing the read lock");
+  rwlock_read_release (&rw);
+  msg ("main: done");
+}
+
+static void
+reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_read_acquire (rw);
+  msg ("reader: got the read lock alongside main");
+  rwlock_read_release (rw);
+}
+
+static void
+writer_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_write_acquire (rw);
+  msg ("writer: got the write lock");
+  rwlock_write_release (rw);
+  msg ("writer: done");
+}
+
+static void
+late_reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_read_acquire (rw);
+  msg ("late reader: got the read lock");
+  rwlock_read_release (rw);
+  msg ("late reader: done");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(synch-rwlock) begin
+(synch-rwlock) reader: got the read lock alongside main
+(synch-rwlock) main: releasing the read lock
+(synch-rwlock) writer: got the write lock
+(synch-rwlock) late reader: got the read lock
+(synch-rwlock) late reader: done
+(synch-rwlock) writer: done
+(synch-rwlock) main: done
+(synch-rwlock) end
+EOF
+pass;
@@ -0,0 +1,63 @@
+/* Checks that a seqlock reader notices a write that happens
+   while it is reading, and gets a consistent snapshot when it
+   retries.  The main thread reads the first of a pair of values,
+   sleeps so that a higher-priority writer can update both, and
+   then reads the second. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+struct pair 
+  {
+    struct seqlock seq;
+    int x, y;
+  };
+
+static thread_func writer_thread_func;
+
+void
+test_synch_seqlock (void) 
+{
+  struct pair p;
+  int x, y;
+  unsigned seq;
+  bool retried = false;
+
+  seqlock_init (&p.seq);
+  p.x = p.y = 0;
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &p, NULL);
+
+  do
+    {
+      if (retried)
+        msg ("reader: retry needed after concurrent write");
+      seq = seqlock_read_begin (&p.seq);
+      x = p.x;
+      if (!retried)
+        timer_sleep (5);
+      y = p.y;
+      retried = true;
+    }
+  while (seqlock_read_retry (&p.seq, seq));
+
+  if (x != y)
+    fail ("inconsistent snapshot %d, %d", x, y);
+  msg ("reader: consistent snapshot %d, %d", x, y);
+}
+
+static void
+writer_thread_func (void *p_) 
+{
+  struct pair *p = p_;
+
+  timer_sleep (1);
+  seqlock_write_begin (&p->seq);
+  p->x++;
+  p->y++;
+  seqlock_write_end (&p->seq);
+  msg ("writer: updated");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(synch-seqlock) begin
+(synch-seqlock) writer: updated
+(synch-seqlock) reader: retry needed after concurrent write
+(synch-seqlock) reader: consistent snapshot 1, 1
+(synch-seqlock) end
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Checks that acquiring a spinlock turns interrupts off and that
+   releasing it restores the interrupt level from before it was
+   acquired, including when spinlocks are nested. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+
+static const char *
+level_name (void) 
+{
+  return intr_get_level () == INTR_ON ? "on" : "off";
+}
+
+void
+test_synch_spinlock (void) 
+{
+  struct spinlock a, b;
+  enum intr_level old_level;
+
+  spinlock_init (&a);
+  spinlock_init (&b);
+  ASSERT (intr_get_level () == INTR_ON);
+
+  spinlock_acquire (&a);
+  msg ("holding a: interrupts %s, a %s", level_name (),
+       spinlock_held (&a) ? "held" : "free");
+  spinlock_acquire (&b);
+  msg ("holding a and b: interrupts %s, b %s", level_name (),
+       spinlock_held (&b) ? "held" : "free");
+  spinlock_release (&b);
+  msg ("released b: interrupts %s, b %s", level_name (),
+       spinlock_held (&b) ? "held" : "free");
+  spinlock_release (&a);
+  msg ("released a: interrupts %s, a %s", level_name (),
+       spinlock_held (&a) ? "held" : "free");
+
+  old_level = intr_disable ();
+  spinlock_acquire (&a);
+  spinlock_release (&a);
+  msg ("acquired and released a with interrupts off: interrupts %s",
+       level_name ());
+  intr_set_level (old_level);
+}
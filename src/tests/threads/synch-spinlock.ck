@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(synch-spinlock) begin
+(synch-spinlock) holding a: interrupts off, a held
+(synch-spinlock) holding a and b: interrupts off, b held
+(synch-spinlock) released b: interrupts off, b free
+(synch-spinlock) released a: interrupts on, a free
+(synch-spinlock) acquired and released a with interrupts off: interrupts off
+(synch-spinlock) end
+EOF
+pass;
@@ -29,6 +29,11 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"synch-spinlock", test_synch_spinlock},
+    {"synch-rwlock", test_synch_rwlock},
+    {"synch-seqlock", test_synch_seqlock},
+    {"synch-contention", test_synch_contention},
+    {"thread-spawn", test_thread_spawn},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
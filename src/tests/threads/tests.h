@@ -23,6 +23,11 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_synch_spinlock;
+extern test_func test_synch_rwlock;
+extern test_func test_synch_seqlock;
+extern test_func test_synch_contention;
+extern test_func test_thread_spawn;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -0,0 +1,69 @@
+/* Microbenchmark for thread creation and exit.  Creates
+   SPAWN_CNT threads one at a time, each of higher priority than
+   the main thread, so that each runs and exits before the next
+   is created; then creates them in batches of BATCH_CNT that all
+   exit together.  Reports the ticks each round took, which are
+   informational only, and checks that every thread ran. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SPAWN_CNT 2000
+#define BATCH_CNT 32
+
+static thread_func spawned;
+
+void
+test_thread_spawn (void) 
+{
+  struct semaphore done;
+  int64_t start;
+  int i, j;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+
+  /* One at a time. */
+  start = timer_ticks ();
+  for (i = 0; i < SPAWN_CNT; i++)
+    {
+      if (thread_create ("spawned", PRI_DEFAULT + 1, spawned, &done,
+                         NULL) == TID_ERROR)
+        fail ("thread_create failed");
+      if (!sema_try_down (&done))
+        fail ("thread %d did not run to completion", i);
+    }
+  msg ("one at a time: %d threads in %"PRId64" ticks",
+       SPAWN_CNT, timer_elapsed (start));
+
+  /* In batches. */
+  start = timer_ticks ();
+  for (i = 0; i < SPAWN_CNT; i += BATCH_CNT)
+    {
+      for (j = 0; j < BATCH_CNT; j++)
+        if (thread_create ("spawned", PRI_DEFAULT, spawned, &done,
+                           NULL) == TID_ERROR)
+          fail ("thread_create failed");
+      for (j = 0; j < BATCH_CNT; j++)
+        sema_down (&done);
+    }
+  msg ("in batches of %d: %d threads in %"PRId64" ticks",
+       BATCH_CNT, i, timer_elapsed (start));
+
+  pass ();
+}
+
+static void
+spawned (void *done_) 
+{
+  struct semaphore *done = done_;
+
+  sema_up (done);
+}
@@ -22,7 +22,9 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #include "vm/frame.h"
+#include "vm/page.h"
 #include "vm/swap.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -36,6 +38,7 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -121,6 +124,7 @@ main (void)
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+  workqueue_init ();
 
 #ifdef FILESYS
   /* Initialize file system. */
@@ -129,8 +133,9 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
-  /* Initialize frame table */
+  /* Initialize frame table and supplemental page table entries. */
   frame_init ();
+  page_init ();
   /* Initialize swap table. */
   swap_init ();
 
@@ -254,6 +259,13 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-cache"))
+        {
+          int cnt = value != NULL ? atoi (value) : 0;
+          if (cnt < 1)
+            PANIC ("bad -cache value");
+          cache_sector_cnt = cnt;
+        }
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -263,6 +275,12 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-fair"))
+        thread_fair = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-memstats"))
+        malloc_memstats = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -270,6 +288,8 @@ parse_options (char **argv)
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
+  if (thread_mlfqs && thread_fair)
+    PANIC ("-mlfqs and -fair are mutually exclusive");
 
   /* Initialize the random number generator based on the system
      time.  This has no effect if an "-rs" option was specified.
@@ -380,12 +400,16 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -cache=COUNT       Cache COUNT file system sectors (default 64).\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -fair              Use fair-share scheduler.\n"
+          "  -tickless          Stop the timer interrupt while idle.\n"
+          "  -memstats          Print allocator statistics at power off.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
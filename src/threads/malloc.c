@@ -8,6 +8,12 @@
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#ifdef MEMSTATS
+#include <inttypes.h>
+#include <stdlib.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#endif
 
 /* A simple implementation of malloc().
 
@@ -32,7 +38,12 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   If the kernel is built with MEMSTATS defined ("make
+   MEMSTATS=1"), every allocation and free is also counted per
+   descriptor and per calling function, and the "-o memstats"
+   kernel option prints the totals at power off. */
 
 /* Descriptor. */
 struct desc
@@ -41,6 +52,14 @@ struct desc
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+#ifdef MEMSTATS
+    size_t arena_cnt;           /* Arenas currently allocated. */
+    size_t peak_arena_cnt;      /* Most arenas ever allocated at once. */
+    size_t live_cnt;            /* Blocks currently allocated. */
+    size_t peak_live_cnt;       /* Most blocks ever allocated at once. */
+    uint64_t alloc_cnt;         /* Total number of allocations. */
+    uint64_t free_cnt;          /* Total number of frees. */
+#endif
   };
 
 /* Magic number for detecting arena corruption. */
@@ -66,6 +85,45 @@ static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void *malloc_from (size_t size, void *caller);
+
+/* If true, print allocator statistics at power off.
+   Controlled by kernel command-line option "-o memstats". */
+bool malloc_memstats;
+
+#ifdef MEMSTATS
+/* Number of distinct calling functions tracked. */
+#define CALL_SITE_CNT 128
+
+/* Allocations made from one calling function. */
+struct call_site
+  {
+    void *caller;               /* Return address into the caller. */
+    uint64_t alloc_cnt;         /* Number of allocations. */
+    uint64_t bytes;             /* Total bytes requested. */
+  };
+
+/* Statistics.  Updated with interrupts off. */
+static struct call_site call_sites[CALL_SITE_CNT];
+static uint64_t untracked_cnt;  /* Allocations with no call site slot. */
+static size_t big_page_cnt;     /* Pages in big blocks now. */
+static size_t peak_big_page_cnt; /* Most pages ever in big blocks. */
+static uint64_t big_alloc_cnt;  /* Total big block allocations. */
+static uint64_t big_free_cnt;   /* Total big block frees. */
+static size_t live_bytes;       /* Bytes in allocated blocks now. */
+static size_t peak_live_bytes;  /* Most bytes ever in allocated blocks. */
+static uint64_t requested_bytes; /* Total bytes requested. */
+static uint64_t allocated_bytes; /* Total bytes in blocks handed out. */
+
+static void stats_alloc (struct desc *, size_t size, size_t block_bytes,
+                         void *caller);
+static void stats_free (struct desc *, size_t block_bytes);
+static void stats_arena (struct desc *, int delta);
+#else
+#define stats_alloc(D, SIZE, BLOCK_BYTES, CALLER) ((void) 0)
+#define stats_free(D, BLOCK_BYTES) ((void) 0)
+#define stats_arena(D, DELTA) ((void) 0)
+#endif
 
 /* Initializes the malloc() descriptors. */
 void
@@ -88,6 +146,13 @@ malloc_init (void)
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) 
+{
+  return malloc_from (size, __builtin_return_address (0));
+}
+
+/* Implements malloc(), crediting the allocation to CALLER. */
+static void *
+malloc_from (size_t size, void *caller UNUSED)
 {
   struct desc *d;
   struct block *b;
@@ -116,6 +181,7 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+      stats_alloc (NULL, size, page_cnt * PGSIZE, caller);
       return a + 1;
     }
 
@@ -138,6 +204,7 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = d;
       a->free_cnt = d->blocks_per_arena;
+      stats_arena (d, 1);
       for (i = 0; i < d->blocks_per_arena; i++) 
         {
           struct block *b = arena_to_block (a, i);
@@ -150,6 +217,7 @@ malloc (size_t size)
   a = block_to_arena (b);
   a->free_cnt--;
   lock_release (&d->lock);
+  stats_alloc (d, size, d->block_size, caller);
   return b;
 }
 
@@ -167,7 +235,7 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = malloc_from (size, __builtin_return_address (0));
   if (p != NULL)
     memset (p, 0, size);
 
@@ -201,7 +269,8 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block = malloc_from (new_size,
+                                     __builtin_return_address (0));
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -233,6 +302,7 @@ free (void *p)
           memset (b, 0xcc, d->block_size);
 #endif
   
+          stats_free (d, d->block_size);
           lock_acquire (&d->lock);
 
           /* Add block to free list. */
@@ -250,6 +320,7 @@ free (void *p)
                   list_remove (&b->free_elem);
                 }
               palloc_free_page (a);
+              stats_arena (d, -1);
             }
 
           lock_release (&d->lock);
@@ -257,6 +328,7 @@ free (void *p)
       else
         {
           /* It's a big block.  Free its pages. */
+          stats_free (NULL, a->free_cnt * PGSIZE);
           palloc_free_multiple (a, a->free_cnt);
           return;
         }
@@ -292,3 +364,152 @@ arena_to_block (struct arena *a, size_t idx)
                            + sizeof *a
                            + idx * a->desc->block_size);
 }
+
+#ifdef MEMSTATS
+/* Records the allocation of a BLOCK_BYTES-byte block from
+   descriptor D (null for a big block) to satisfy a SIZE-byte
+   request made by CALLER. */
+static void
+stats_alloc (struct desc *d, size_t size, size_t block_bytes, void *caller)
+{
+  enum intr_level old_level = intr_disable ();
+  size_t i, probe;
+
+  if (d != NULL)
+    {
+      d->alloc_cnt++;
+      if (++d->live_cnt > d->peak_live_cnt)
+        d->peak_live_cnt = d->live_cnt;
+    }
+  else
+    {
+      big_alloc_cnt++;
+      big_page_cnt += block_bytes / PGSIZE;
+      if (big_page_cnt > peak_big_page_cnt)
+        peak_big_page_cnt = big_page_cnt;
+    }
+
+  live_bytes += block_bytes;
+  if (live_bytes > peak_live_bytes)
+    peak_live_bytes = live_bytes;
+  requested_bytes += size;
+  allocated_bytes += block_bytes;
+
+  /* Credit CALLER, using open addressing on its address. */
+  probe = ((uintptr_t) caller >> 2) % CALL_SITE_CNT;
+  for (i = 0; i < CALL_SITE_CNT; i++)
+    {
+      struct call_site *cs = &call_sites[(probe + i) % CALL_SITE_CNT];
+      if (cs->caller == NULL)
+        cs->caller = caller;
+      if (cs->caller == caller)
+        {
+          cs->alloc_cnt++;
+          cs->bytes += size;
+          break;
+        }
+    }
+  if (i == CALL_SITE_CNT)
+    untracked_cnt++;
+
+  intr_set_level (old_level);
+}
+
+/* Records the freeing of a BLOCK_BYTES-byte block from
+   descriptor D (null for a big block). */
+static void
+stats_free (struct desc *d, size_t block_bytes)
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (d != NULL)
+    {
+      d->free_cnt++;
+      d->live_cnt--;
+    }
+  else
+    {
+      big_free_cnt++;
+      big_page_cnt -= block_bytes / PGSIZE;
+    }
+  live_bytes -= block_bytes;
+
+  intr_set_level (old_level);
+}
+
+/* Records that descriptor D gained (DELTA = 1) or gave back
+   (DELTA = -1) an arena. */
+static void
+stats_arena (struct desc *d, int delta)
+{
+  enum intr_level old_level = intr_disable ();
+
+  d->arena_cnt += delta;
+  if (d->arena_cnt > d->peak_arena_cnt)
+    d->peak_arena_cnt = d->arena_cnt;
+
+  intr_set_level (old_level);
+}
+
+/* Orders call sites by descending bytes requested. */
+static int
+call_site_compare (const void *a_, const void *b_)
+{
+  const struct call_site *a = a_;
+  const struct call_site *b = b_;
+
+  return a->bytes < b->bytes ? 1 : a->bytes > b->bytes ? -1 : 0;
+}
+
+/* Returns COUNT events per second over the time since boot. */
+static uint64_t
+per_second (uint64_t count)
+{
+  int64_t ticks = timer_ticks ();
+  return ticks > 0 ? count * TIMER_FREQ / ticks : count;
+}
+
+/* Prints malloc() statistics.  Sorts the call site table, so
+   should only be called when the system is shutting down. */
+void
+malloc_print_stats (void)
+{
+  size_t i;
+
+  printf ("Malloc: %zu bytes live, %zu peak; "
+          "%"PRIu64" of %"PRIu64" bytes allocated were requested\n",
+          live_bytes, peak_live_bytes, requested_bytes, allocated_bytes);
+  for (i = 0; i < desc_cnt; i++)
+    {
+      struct desc *d = &descs[i];
+      printf ("  %4zu-byte blocks: %zu arenas (peak %zu), "
+              "%zu used and %zu free blocks (peak %zu used), "
+              "%"PRIu64" allocs (%"PRIu64"/s), "
+              "%"PRIu64" frees (%"PRIu64"/s)\n",
+              d->block_size, d->arena_cnt, d->peak_arena_cnt, d->live_cnt,
+              d->arena_cnt * d->blocks_per_arena - d->live_cnt,
+              d->peak_live_cnt, d->alloc_cnt, per_second (d->alloc_cnt),
+              d->free_cnt, per_second (d->free_cnt));
+    }
+  printf ("  big blocks: %zu pages (peak %zu), "
+          "%"PRIu64" allocs, %"PRIu64" frees\n",
+          big_page_cnt, peak_big_page_cnt, big_alloc_cnt, big_free_cnt);
+
+  printf ("Malloc call sites by bytes requested:\n");
+  qsort (call_sites, CALL_SITE_CNT, sizeof *call_sites, call_site_compare);
+  for (i = 0; i < 10 && call_sites[i].caller != NULL; i++)
+    printf ("  %p: %"PRIu64" bytes in %"PRIu64" allocs\n",
+            call_sites[i].caller, call_sites[i].bytes,
+            call_sites[i].alloc_cnt);
+  if (untracked_cnt > 0)
+    printf ("  (%"PRIu64" allocs from untracked call sites)\n",
+            untracked_cnt);
+}
+#else /* !MEMSTATS */
+/* Prints malloc() statistics, which are not compiled in. */
+void
+malloc_print_stats (void)
+{
+  printf ("Malloc: statistics not compiled in (build with MEMSTATS=1)\n");
+}
+#endif /* MEMSTATS */
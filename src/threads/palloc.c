@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
@@ -24,17 +25,82 @@
    even if user processes are swapping like mad.
 
    By default, half of system RAM is given to the kernel pool and
-   half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   half to the user pool to begin with.  The split is not fixed:
+   both pools' bitmaps cover all of free memory, with the pages a
+   pool does not own marked as used in its bitmap, and
+   user_owned_map records which pool owns each page.  When a pool
+   runs dry it borrows a run of free pages (at least LEND_CHUNK)
+   from the other pool, as long as the other pool keeps at least
+   its reserve_cnt pages free.  Thus the kernel does not fail
+   thread_create() while user memory sits idle, and user
+   processes do not evict frames while kernel memory sits idle.
 
-static void init_pool (struct pool *, void *base, size_t page_cnt,
+   Single pages are handed out through small per-thread
+   "magazines" (see struct page_magazine in palloc.h).  A thread
+   allocates from and frees into its own magazine without taking
+   the pool lock; only when the magazine runs empty or full is a
+   batch of MAG_BATCH pages moved to or from the pool under the
+   lock.  When a pool runs dry, palloc_drain_all_magazines()
+   returns every cached page to its pool before we give up,
+   including the pages that the thread code keeps for new
+   threads.
+
+   Each pool also keeps a few free pages that are already filled
+   with zeros, so that single-page PAL_ZERO requests (stacks,
+   page tables, fresh anonymous pages) need not clear a page on
+   their critical path.  The idle thread refills these by calling
+   palloc_zero_idle() whenever it has nothing else to do. */
+
+/* Smallest number of pages one pool lends the other at once. */
+#define LEND_CHUNK 32
+
+/* Number of pages moved between a magazine and its pool at once. */
+#define MAG_BATCH (PALLOC_MAG_SIZE / 2)
+
+/* Heads of chains of free pages, linked through their first
+   word, collected from magazines for returning to the pools. */
+struct page_chains
+  {
+    void *kernel;                       /* Pages for kernel_pool. */
+    void *user;                         /* Pages for user_pool. */
+  };
+
+static void init_pool (struct pool *, uint8_t *base, size_t page_cnt,
+                       void *bm_buf, size_t bm_size, size_t start,
+                       size_t cnt, size_t max_cnt, size_t reserve_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static bool pool_borrow (struct pool *, size_t page_cnt);
+static size_t find_lendable (const struct pool *, const struct pool *donor,
+                             size_t cnt);
+static void *pool_get_multiple (struct pool *, size_t page_cnt);
+static size_t pool_get_pages (struct pool *, void **pages, size_t cnt);
+static void pool_put_pages (struct pool *, void **pages, size_t cnt);
+static bool pool_lock_usable (void);
+static struct page_magazine *thread_magazine (struct thread *,
+                                              const struct pool *);
+static void *magazine_get (struct pool *);
+static void magazine_put (struct pool *, void *page);
+static void *zeroed_get (struct pool *);
+static void collect_magazines (struct thread *, void *chains_);
+static size_t free_page_chain (struct pool *, void *chain);
+
+#ifdef MEMSTATS
+static void stats_pages (struct pool *, int page_delta);
+static void stats_count (uint64_t *counter);
+#else
+#define stats_pages(POOL, PAGE_DELTA) ((void) 0)
+#define stats_count(COUNTER) ((void) 0)
+#endif
 
 static struct pool kernel_pool, user_pool;
 
+/* Pages owned by the user pool (true) or the kernel pool (false).
+   Changes only for free pages, with both pool locks held. */
+static struct bitmap *user_owned_map;
+
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
-   pages are put into the user pool. */
+   pages are ever owned by the user pool. */
 void
 palloc_init (size_t user_page_limit)
 {
@@ -42,16 +108,34 @@ palloc_init (size_t user_page_limit)
   uint8_t *free_start = ptov (1024 * 1024);
   uint8_t *free_end = ptov (init_ram_pages * PGSIZE);
   size_t free_pages = (free_end - free_start) / PGSIZE;
-  size_t user_pages = free_pages / 2;
-  size_t kernel_pages;
+  size_t bm_size = bitmap_buf_size (free_pages);
+  size_t bm_pages = DIV_ROUND_UP (3 * bm_size, PGSIZE);
+  size_t page_cnt, user_pages, kernel_pages;
+  uint8_t *base;
+
+  /* We'll put the three bitmaps at the start of free memory.
+     The rest is shared between the pools. */
+  if (bm_pages >= free_pages)
+    PANIC ("Not enough memory for page allocator bitmaps.");
+  page_cnt = free_pages - bm_pages;
+  base = free_start + bm_pages * PGSIZE;
+
+  /* Start with half of memory for kernel, half for user. */
+  user_pages = page_cnt / 2;
   if (user_pages > user_page_limit)
     user_pages = user_page_limit;
-  kernel_pages = free_pages - user_pages;
+  kernel_pages = page_cnt - user_pages;
 
-  /* Give half of memory to kernel, half to user. */
-  init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
-  init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
-             user_pages, "user pool");
+  /* The kernel cannot evict its pages, so it holds more back
+     from lending than the user pool does. */
+  init_pool (&kernel_pool, base, page_cnt, free_start, bm_size,
+             0, kernel_pages, SIZE_MAX, kernel_pages / 4, "kernel pool");
+  init_pool (&user_pool, base, page_cnt, free_start + bm_size, bm_size,
+             kernel_pages, user_pages, user_page_limit, user_pages / 16,
+             "user pool");
+  user_owned_map = bitmap_create_in_buf (page_cnt, free_start + 2 * bm_size,
+                                         bm_size);
+  bitmap_set_multiple (user_owned_map, kernel_pages, user_pages, true);
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -65,22 +149,35 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
   void *pages;
-  size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  /* Prefer a page zeroed in advance by the idle thread. */
+  if ((flags & PAL_ZERO) && page_cnt == 1)
+    {
+      pages = zeroed_get (pool);
+      if (pages != NULL)
+        {
+          stats_pages (pool, 1);
+          stats_count (&pool->zeroed_hit_cnt);
+          return pages;
+        }
+    }
 
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+  pages = pool_get_multiple (pool, page_cnt);
+
+  /* Pages may be sitting unused in other threads' magazines. */
+  if (pages == NULL && palloc_drain_all_magazines () > 0)
+    pages = pool_get_multiple (pool, page_cnt);
+
+  /* The other pool may have pages to spare. */
+  if (pages == NULL && pool_borrow (pool, page_cnt))
+    pages = pool_get_multiple (pool, page_cnt);
 
   if (pages != NULL) 
     {
+      stats_pages (pool, page_cnt);
       if (flags & PAL_ZERO)
         memset (pages, 0, PGSIZE * page_cnt);
     }
@@ -139,12 +236,6 @@ palloc_get_page (enum palloc_flags flags)
   return palloc_get_multiple (flags, 1);
 }
 
-struct pool *
-get_user_pool ()
-{
-  return &user_pool;
-}
-
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) 
@@ -170,7 +261,11 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 #endif
 
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  stats_pages (pool, -(int) page_cnt);
+  if (page_cnt == 1)
+    magazine_put (pool, pages);
+  else
+    bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
 }
 
 /* Frees the page at PAGE. */
@@ -180,25 +275,139 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
-/* Initializes pool P as starting at START and ending at END,
-   naming it NAME for debugging purposes. */
-static void
-init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
+/* Returns all pages cached in thread T's magazines to their
+   pools.  Called when T exits, so that its cached pages are not
+   lost with it. */
+void
+palloc_drain_magazine (struct thread *t)
+{
+  struct page_chains chains = { NULL, NULL };
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  collect_magazines (t, &chains);
+  intr_set_level (old_level);
+
+  free_page_chain (&kernel_pool, chains.kernel);
+  free_page_chain (&user_pool, chains.user);
+}
+
+/* Returns the pages cached in every thread's magazines, the
+   pre-zeroed pages, and the pages of exited threads kept for new
+   threads, to their pools, for use when memory is short.
+   Returns the number of pages returned. */
+size_t
+palloc_drain_all_magazines (void)
+{
+  struct page_chains chains = { NULL, NULL };
+  enum intr_level old_level;
+  void *thread_pages;
+
+  old_level = intr_disable ();
+  thread_foreach (collect_magazines, &chains);
+
+  /* Thread pages were never freed, so they still count as in
+     use.  They come from the kernel pool, but it may have
+     borrowed them from the user pool. */
+  thread_pages = thread_take_cached_pages ();
+  while (thread_pages != NULL)
+    {
+      void **page = thread_pages;
+      void **chain;
+
+      thread_pages = *page;
+      if (page_from_pool (&kernel_pool, page))
+        {
+          stats_pages (&kernel_pool, -1);
+          chain = &chains.kernel;
+        }
+      else
+        {
+          stats_pages (&user_pool, -1);
+          chain = &chains.user;
+        }
+      *page = *chain;
+      *chain = page;
+    }
+
+  while (kernel_pool.zeroed_cnt > 0)
+    {
+      void **page = kernel_pool.zeroed[--kernel_pool.zeroed_cnt];
+      *page = chains.kernel;
+      chains.kernel = page;
+    }
+  while (user_pool.zeroed_cnt > 0)
+    {
+      void **page = user_pool.zeroed[--user_pool.zeroed_cnt];
+      *page = chains.user;
+      chains.user = page;
+    }
+  intr_set_level (old_level);
+
+  return (free_page_chain (&kernel_pool, chains.kernel)
+          + free_page_chain (&user_pool, chains.user));
+}
+
+/* Zeroes one free page for the pool with fewer pre-zeroed pages,
+   for later PAL_ZERO requests.  Returns true if a page was
+   zeroed, false if there was nothing to do or the pool was busy.
+
+   Called by the idle thread, which must never sleep, so the pool
+   lock is only tried, not waited for. */
+bool
+palloc_zero_idle (void)
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  struct pool *pool;
+  enum intr_level old_level;
+  size_t page_idx;
+  void *page;
+
+  pool = user_pool.zeroed_cnt <= kernel_pool.zeroed_cnt
+         ? &user_pool : &kernel_pool;
+  if (pool->zeroed_cnt >= PALLOC_ZEROED_CNT)
+    return false;
 
-  printf ("%zu pages available in %s.\n", page_cnt, name);
+  if (!lock_try_acquire (&pool->lock))
+    return false;
+  page_idx = bitmap_scan_and_flip (pool->used_map, 0, 1, false);
+  lock_release (&pool->lock);
+  if (page_idx == BITMAP_ERROR)
+    return false;
+
+  page = pool->base + PGSIZE * page_idx;
+  memset (page, 0, PGSIZE);
+
+  /* Only the idle thread adds pages, so there is still room. */
+  old_level = intr_disable ();
+  pool->zeroed[pool->zeroed_cnt++] = page;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Initializes pool P over the PAGE_CNT pages starting at BASE,
+   putting its used_map in the BM_SIZE bytes at BM_BUF.  P owns
+   the CNT pages starting at page index START, may grow to own
+   MAX_CNT pages, and never lends out its last RESERVE_CNT free
+   pages.  P is named NAME for debugging purposes. */
+static void
+init_pool (struct pool *p, uint8_t *base, size_t page_cnt,
+           void *bm_buf, size_t bm_size, size_t start, size_t cnt,
+           size_t max_cnt, size_t reserve_cnt, const char *name) 
+{
+  printf ("%zu pages available in %s.\n", cnt, name);
 
   /* Initialize the pool. */
   lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+#ifdef MEMSTATS
+  p->name = name;
+#endif
+  p->used_map = bitmap_create_in_buf (page_cnt, bm_buf, bm_size);
+  bitmap_set_all (p->used_map, true);
+  bitmap_set_multiple (p->used_map, start, cnt, false);
+  p->base = base;
+  p->page_cnt = cnt;
+  p->max_page_cnt = max_cnt;
+  p->reserve_cnt = reserve_cnt;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -210,5 +419,333 @@ page_from_pool (const struct pool *pool, void *page)
   size_t start_page = pg_no (pool->base);
   size_t end_page = start_page + bitmap_size (pool->used_map);
 
-  return page_no >= start_page && page_no < end_page;
+  return (page_no >= start_page && page_no < end_page
+          && (bitmap_test (user_owned_map, page_no - start_page)
+              == (pool == &user_pool)));
+}
+
+/* Moves free pages from the other pool to POOL, enough for an
+   allocation of PAGE_CNT contiguous pages, and LEND_CHUNK pages
+   if possible.  Returns true if successful, false if the other
+   pool has no such run to spare or POOL is at its size limit. */
+static bool
+pool_borrow (struct pool *pool, size_t page_cnt)
+{
+  struct pool *donor = pool == &user_pool ? &kernel_pool : &user_pool;
+  size_t cnt = page_cnt > LEND_CHUNK ? page_cnt : LEND_CHUNK;
+  size_t page_idx;
+
+  /* Always lock the kernel pool first, to avoid deadlock. */
+  lock_acquire (&kernel_pool.lock);
+  lock_acquire (&user_pool.lock);
+
+  page_idx = find_lendable (pool, donor, cnt);
+  if (page_idx == BITMAP_ERROR && cnt > page_cnt)
+    {
+      cnt = page_cnt;
+      page_idx = find_lendable (pool, donor, cnt);
+    }
+
+  if (page_idx != BITMAP_ERROR)
+    {
+      bitmap_set_multiple (donor->used_map, page_idx, cnt, true);
+      bitmap_set_multiple (user_owned_map, page_idx, cnt,
+                           pool == &user_pool);
+      bitmap_set_multiple (pool->used_map, page_idx, cnt, false);
+      donor->page_cnt -= cnt;
+      pool->page_cnt += cnt;
+#ifdef MEMSTATS
+      pool->borrow_cnt += cnt;
+#endif
+    }
+
+  lock_release (&user_pool.lock);
+  lock_release (&kernel_pool.lock);
+
+  return page_idx != BITMAP_ERROR;
+}
+
+/* Returns the index of the first run of CNT free pages that
+   DONOR can lend POOL, or BITMAP_ERROR if there is none.  Both
+   pool locks must be held. */
+static size_t
+find_lendable (const struct pool *pool, const struct pool *donor,
+               size_t cnt)
+{
+  size_t donor_free;
+
+  if (pool->page_cnt + cnt > pool->max_page_cnt)
+    return BITMAP_ERROR;
+
+  donor_free = bitmap_count (donor->used_map, 0,
+                             bitmap_size (donor->used_map), false);
+  if (donor_free < donor->reserve_cnt + cnt)
+    return BITMAP_ERROR;
+
+  return bitmap_scan (donor->used_map, 0, cnt, false);
+}
+
+/* Obtains PAGE_CNT contiguous free pages from POOL, going
+   through the current thread's magazine for single pages.
+   Returns a null pointer if POOL has too few free pages. */
+static void *
+pool_get_multiple (struct pool *pool, size_t page_cnt)
+{
+  size_t page_idx;
+
+  if (page_cnt == 1)
+    return magazine_get (pool);
+
+  lock_acquire (&pool->lock);
+  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  lock_release (&pool->lock);
+
+  return page_idx != BITMAP_ERROR ? pool->base + PGSIZE * page_idx : NULL;
+}
+
+/* Marks up to CNT single free pages in POOL as used under one
+   acquisition of the pool lock, storing them into PAGES.
+   Returns the number of pages obtained. */
+static size_t
+pool_get_pages (struct pool *pool, void **pages, size_t cnt)
+{
+  size_t page_idx = 0;
+  size_t got;
+
+  lock_acquire (&pool->lock);
+  for (got = 0; got < cnt; got++)
+    {
+      page_idx = bitmap_scan_and_flip (pool->used_map, page_idx, 1, false);
+      if (page_idx == BITMAP_ERROR)
+        break;
+      pages[got] = pool->base + PGSIZE * page_idx;
+    }
+  lock_release (&pool->lock);
+
+  return got;
+}
+
+/* Marks the CNT single pages in PAGES as free in POOL. */
+static void
+pool_put_pages (struct pool *pool, void **pages, size_t cnt)
+{
+  bool locked = pool_lock_usable ();
+  size_t i;
+
+  if (locked)
+    lock_acquire (&pool->lock);
+  for (i = 0; i < cnt; i++)
+    {
+      size_t page_idx = pg_no (pages[i]) - pg_no (pool->base);
+      ASSERT (bitmap_test (pool->used_map, page_idx));
+      bitmap_reset (pool->used_map, page_idx);
+    }
+  if (locked)
+    lock_release (&pool->lock);
+}
+
+/* Returns true if the pool lock may be taken here.  Pages are
+   also freed from thread_schedule_tail(), with interrupts off,
+   where we must not sleep on the lock; there, as palloc has
+   always done, the bitmap is updated without it. */
+static bool
+pool_lock_usable (void)
+{
+  return !intr_context () && intr_get_level () == INTR_ON;
+}
+
+/* Returns thread T's magazine for POOL. */
+static struct page_magazine *
+thread_magazine (struct thread *t, const struct pool *pool)
+{
+  return pool == &user_pool ? &t->user_mag : &t->kernel_mag;
+}
+
+/* Takes a pre-zeroed free page from POOL.
+   Returns a null pointer if POOL has none. */
+static void *
+zeroed_get (struct pool *pool)
+{
+  enum intr_level old_level;
+  void *page = NULL;
+
+  old_level = intr_disable ();
+  if (pool->zeroed_cnt > 0)
+    page = pool->zeroed[--pool->zeroed_cnt];
+  intr_set_level (old_level);
+
+  return page;
+}
+
+/* Takes a free page of POOL from the current thread's magazine,
+   refilling the magazine from POOL first if it is empty.
+   Returns a null pointer if POOL has no free pages. */
+static void *
+magazine_get (struct pool *pool)
+{
+  struct page_magazine *mag = thread_magazine (thread_current (), pool);
+  enum intr_level old_level;
+  void *page = NULL;
+
+  if (mag->page_cnt == 0)
+    {
+      void *batch[MAG_BATCH];
+      size_t cnt = pool_get_pages (pool, batch, MAG_BATCH);
+      size_t room, keep;
+      stats_count (&pool->refill_cnt);
+
+      /* While we slept in pool_get_pages(), pages may have been
+         freed into our magazine, e.g. by thread_schedule_tail()
+         freeing a dying thread's page on our behalf.  Keep only
+         what fits and give the rest back. */
+      old_level = intr_disable ();
+      room = PALLOC_MAG_SIZE - mag->page_cnt;
+      keep = cnt < room ? cnt : room;
+      memcpy (mag->pages + mag->page_cnt, batch, keep * sizeof *batch);
+      mag->page_cnt += keep;
+      intr_set_level (old_level);
+
+      if (keep < cnt)
+        pool_put_pages (pool, batch + keep, cnt - keep);
+    }
+
+  /* A magazine may be drained by another thread under memory
+     pressure, so pop with interrupts off. */
+  old_level = intr_disable ();
+  if (mag->page_cnt > 0)
+    page = mag->pages[--mag->page_cnt];
+  intr_set_level (old_level);
+
+  return page;
+}
+
+/* Puts free PAGE of POOL into the current thread's magazine,
+   first returning a batch of pages to POOL if it is full. */
+static void
+magazine_put (struct pool *pool, void *page)
+{
+  struct page_magazine *mag = thread_magazine (thread_current (), pool);
+  void *batch[MAG_BATCH];
+  size_t cnt = 0;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (mag->page_cnt == PALLOC_MAG_SIZE)
+    {
+      cnt = MAG_BATCH;
+      mag->page_cnt -= cnt;
+      memcpy (batch, mag->pages + mag->page_cnt, cnt * sizeof *batch);
+    }
+  mag->pages[mag->page_cnt++] = page;
+  intr_set_level (old_level);
+
+  if (cnt > 0)
+    {
+      stats_count (&pool->spill_cnt);
+      pool_put_pages (pool, batch, cnt);
+    }
+}
+
+/* Empties thread T's magazines onto the chains in CHAINS_, a
+   struct page_chains.  Must be called with interrupts off. */
+static void
+collect_magazines (struct thread *t, void *chains_)
+{
+  struct page_chains *chains = chains_;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (t->kernel_mag.page_cnt > 0)
+    {
+      void **page = t->kernel_mag.pages[--t->kernel_mag.page_cnt];
+      *page = chains->kernel;
+      chains->kernel = page;
+    }
+  while (t->user_mag.page_cnt > 0)
+    {
+      void **page = t->user_mag.pages[--t->user_mag.page_cnt];
+      *page = chains->user;
+      chains->user = page;
+    }
+}
+
+/* Marks every page on CHAIN as free in POOL, in batches.
+   Returns the number of pages freed. */
+static size_t
+free_page_chain (struct pool *pool, void *chain)
+{
+  void *batch[MAG_BATCH];
+  size_t cnt = 0;
+  size_t total = 0;
+
+  while (chain != NULL)
+    {
+      batch[cnt++] = chain;
+      chain = *(void **) chain;
+      if (cnt == MAG_BATCH || chain == NULL)
+        {
+          pool_put_pages (pool, batch, cnt);
+          total += cnt;
+          cnt = 0;
+        }
+    }
+  return total;
+}
+
+#ifdef MEMSTATS
+/* Records that PAGE_DELTA pages of POOL were handed out
+   (positive) or given back (negative) by palloc's callers. */
+static void
+stats_pages (struct pool *pool, int page_delta)
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (page_delta > 0)
+    pool->alloc_cnt++;
+  else
+    pool->free_cnt++;
+  pool->used_cnt += page_delta;
+  if (pool->used_cnt > pool->peak_used_cnt)
+    pool->peak_used_cnt = pool->used_cnt;
+
+  intr_set_level (old_level);
+}
+
+/* Increments statistics COUNTER. */
+static void
+stats_count (uint64_t *counter)
+{
+  enum intr_level old_level = intr_disable ();
+  (*counter)++;
+  intr_set_level (old_level);
+}
+
+/* Prints statistics for POOL. */
+static void
+print_pool_stats (const struct pool *pool)
+{
+  printf ("Palloc: %s: %zu of %zu pages used (peak %zu), "
+          "%"PRIu64" allocs, %"PRIu64" frees, "
+          "%"PRIu64" magazine refills, %"PRIu64" spills, "
+          "%"PRIu64" pre-zeroed, %"PRIu64" borrowed\n",
+          pool->name, pool->used_cnt, pool->page_cnt,
+          pool->peak_used_cnt, pool->alloc_cnt, pool->free_cnt,
+          pool->refill_cnt, pool->spill_cnt, pool->zeroed_hit_cnt,
+          pool->borrow_cnt);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void)
+{
+  print_pool_stats (&kernel_pool);
+  print_pool_stats (&user_pool);
+}
+#else /* !MEMSTATS */
+/* Prints page allocator statistics, which are not compiled in. */
+void
+palloc_print_stats (void)
+{
+  printf ("Palloc: statistics not compiled in (build with MEMSTATS=1)\n");
 }
+#endif /* MEMSTATS */
@@ -13,11 +13,43 @@ enum palloc_flags
     PAL_USER = 004              /* User page. */
   };
 
+/* Number of free pages a per-thread magazine can cache. */
+#define PALLOC_MAG_SIZE 8
+
+/* A small per-thread cache ("magazine") of free single pages
+   taken from one pool.  Refilled from and drained to the pool in
+   batches, so that most single-page allocations and frees do not
+   touch the pool lock.  Owned by palloc.c. */
+struct page_magazine
+  {
+    size_t page_cnt;                    /* Number of cached pages. */
+    void *pages[PALLOC_MAG_SIZE];       /* Cached free pages. */
+  };
+
+/* Number of pre-zeroed free pages each pool keeps. */
+#define PALLOC_ZEROED_CNT 16
+
 struct pool
 {
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages owned. */
+    size_t max_page_cnt;                /* Most pages it may own. */
+    size_t reserve_cnt;                 /* Free pages it never lends. */
+    void *zeroed[PALLOC_ZEROED_CNT];    /* Free pages already zeroed. */
+    size_t zeroed_cnt;                  /* Number of pages in ZEROED. */
+#ifdef MEMSTATS
+    const char *name;                   /* Name, for statistics. */
+    size_t used_cnt;                    /* Pages handed out now. */
+    size_t peak_used_cnt;               /* Most pages ever handed out. */
+    uint64_t alloc_cnt;                 /* Total allocation calls. */
+    uint64_t free_cnt;                  /* Total free calls. */
+    uint64_t refill_cnt;                /* Magazine refills from pool. */
+    uint64_t spill_cnt;                 /* Magazine spills to pool. */
+    uint64_t zeroed_hit_cnt;            /* PAL_ZERO pages pre-zeroed. */
+    uint64_t borrow_cnt;                /* Pages borrowed from other pool. */
+#endif
 };
 
 void palloc_init (size_t user_page_limit);
@@ -25,6 +57,11 @@ void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
-struct pool * get_user_pool (void);
+
+struct thread;
+void palloc_drain_magazine (struct thread *);
+size_t palloc_drain_all_magazines (void);
+bool palloc_zero_idle (void);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,211 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator for fixed-size kernel objects.
+
+   malloc() rounds every request up to a power of 2, so a 28-byte
+   object takes a 32-byte block, and a 36-byte one a 64-byte
+   block.  A slab cache instead serves objects of exactly one
+   size (rounded up only to the requested alignment) out of
+   single pages called slabs.  Each slab starts with a header,
+   followed by as many objects as fit in the rest of the page;
+   its free objects are kept on a list threaded through the
+   objects themselves.
+
+   The cache keeps slabs that have some free objects on its
+   `partial' list, from which allocations are satisfied, and
+   slabs with none on its `full' list.  When a slab becomes
+   entirely free it is kept as the cache's reserve if it has
+   none, otherwise returned to the page allocator, so that a
+   cache hovering around a slab boundary does not thrash pages. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Slab header, at the start of each slab's page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct slab_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's partial or full list. */
+    size_t free_cnt;            /* Number of free objects. */
+    struct free_obj *free;      /* List of free objects. */
+  };
+
+/* Free object. */
+struct free_obj
+  {
+    struct free_obj *next;      /* Next free object in slab. */
+  };
+
+static struct slab *slab_create (struct slab_cache *);
+static struct slab *obj_to_slab (struct slab_cache *, void *);
+
+/* Initializes CACHE to hand out objects of SIZE bytes aligned on
+   ALIGN-byte boundaries, named NAME for debugging purposes.  If
+   CTOR is non-null, it is called on each object as it is
+   allocated.  No memory is allocated until the first call to
+   slab_alloc(), so this may be called before palloc_init(). */
+void
+slab_cache_init (struct slab_cache *cache, const char *name, size_t size,
+                 size_t align, slab_ctor_func *ctor)
+{
+  ASSERT (cache != NULL);
+  ASSERT (size > 0);
+  ASSERT (align > 0);
+
+  if (size < sizeof (struct free_obj))
+    size = sizeof (struct free_obj);
+
+  cache->name = name;
+  cache->obj_size = ROUND_UP (size, align);
+  cache->obj_ofs = ROUND_UP (sizeof (struct slab), align);
+  ASSERT (cache->obj_ofs + cache->obj_size <= PGSIZE);
+  cache->objs_per_slab = (PGSIZE - cache->obj_ofs) / cache->obj_size;
+  cache->ctor = ctor;
+  list_init (&cache->partial);
+  list_init (&cache->full);
+  cache->empty = NULL;
+  lock_init (&cache->lock);
+}
+
+/* Obtains and returns a new object from CACHE.
+   Returns a null pointer if memory is not available. */
+void *
+slab_alloc (struct slab_cache *cache)
+{
+  struct slab *s;
+  struct free_obj *obj;
+
+  lock_acquire (&cache->lock);
+
+  /* Find a slab with a free object, creating one if needed. */
+  if (!list_empty (&cache->partial))
+    s = list_entry (list_front (&cache->partial), struct slab, elem);
+  else
+    {
+      if (cache->empty != NULL)
+        {
+          s = cache->empty;
+          cache->empty = NULL;
+        }
+      else
+        {
+          s = slab_create (cache);
+          if (s == NULL)
+            {
+              lock_release (&cache->lock);
+              return NULL;
+            }
+        }
+      list_push_front (&cache->partial, &s->elem);
+    }
+
+  /* Take its first free object. */
+  obj = s->free;
+  s->free = obj->next;
+  if (--s->free_cnt == 0)
+    {
+      list_remove (&s->elem);
+      list_push_front (&cache->full, &s->elem);
+    }
+
+  lock_release (&cache->lock);
+
+  if (cache->ctor != NULL)
+    cache->ctor (obj);
+  return obj;
+}
+
+/* Frees OBJ, which must have been obtained from CACHE with
+   slab_alloc().  A null OBJ is ignored. */
+void
+slab_free (struct slab_cache *cache, void *obj_)
+{
+  struct free_obj *obj = obj_;
+  struct slab *s;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (cache, obj);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs. */
+  memset (obj, 0xcc, cache->obj_size);
+#endif
+
+  lock_acquire (&cache->lock);
+
+  obj->next = s->free;
+  s->free = obj;
+  if (s->free_cnt++ == 0)
+    {
+      /* Slab was full, now it is partial. */
+      list_remove (&s->elem);
+      list_push_front (&cache->partial, &s->elem);
+    }
+  if (s->free_cnt == cache->objs_per_slab)
+    {
+      /* Slab is entirely free.  Keep it in reserve or release it. */
+      list_remove (&s->elem);
+      if (cache->empty == NULL)
+        cache->empty = s;
+      else
+        {
+          s->magic = 0;
+          palloc_free_page (s);
+        }
+    }
+
+  lock_release (&cache->lock);
+}
+
+/* Allocates a new slab for CACHE and divides it into free
+   objects.  Returns a null pointer if no page is available. */
+static struct slab *
+slab_create (struct slab_cache *cache)
+{
+  struct slab *s = palloc_get_page (0);
+  size_t i;
+
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = cache;
+  s->free_cnt = cache->objs_per_slab;
+  s->free = NULL;
+  for (i = cache->objs_per_slab; i-- > 0; )
+    {
+      struct free_obj *obj = (struct free_obj *) ((uint8_t *) s
+                                                  + cache->obj_ofs
+                                                  + i * cache->obj_size);
+      obj->next = s->free;
+      s->free = obj;
+    }
+  return s;
+}
+
+/* Returns the slab of CACHE that OBJ is inside. */
+static struct slab *
+obj_to_slab (struct slab_cache *cache, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid and belongs to CACHE. */
+  ASSERT (s != NULL);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == cache);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT (pg_ofs (obj) >= cache->obj_ofs);
+  ASSERT ((pg_ofs (obj) - cache->obj_ofs) % cache->obj_size == 0);
+
+  return s;
+}
@@ -0,0 +1,31 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* Initializes a newly allocated object OBJ of a slab cache. */
+typedef void slab_ctor_func (void *obj);
+
+/* A cache of equally sized objects, carved out of whole pages
+   ("slabs") obtained from the page allocator. */
+struct slab_cache
+  {
+    const char *name;           /* Name (for debugging purposes). */
+    size_t obj_size;            /* Size of each object, after alignment. */
+    size_t obj_ofs;             /* Offset of first object in a slab. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    slab_ctor_func *ctor;       /* Constructor, or a null pointer. */
+    struct list partial;        /* Slabs with some free objects. */
+    struct list full;           /* Slabs with no free objects. */
+    struct slab *empty;         /* One wholly free slab kept in reserve. */
+    struct lock lock;           /* Lock. */
+  };
+
+void slab_cache_init (struct slab_cache *, const char *name, size_t size,
+                      size_t align, slab_ctor_func *);
+void *slab_alloc (struct slab_cache *);
+void slab_free (struct slab_cache *, void *);
+
+#endif /* threads/slab.h */
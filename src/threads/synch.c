@@ -127,6 +127,8 @@ sema_up (struct semaphore *sema)
 }
 
 static void sema_test_helper (void *sema_);
+static void lock_take (struct lock *);
+static heap_less_func waiter_has_lower_priority;
 
 /* Self-test for semaphores that makes control "ping-pong"
    between a pair of threads.  Insert calls to printf() to see
@@ -177,7 +179,14 @@ sema_test_helper (void *sema_)
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   Threads waiting for a lock donate their priority to its
+   holder.  Each lock keeps its waiters in a heap by priority,
+   and each thread keeps the locks it holds in a heap by the
+   highest priority waiting for them, so that a thread's
+   donated priority is the top of its heap.  See
+   thread_donate_priority() and thread_choose_priority(). */
 void
 lock_init (struct lock *lock)
 {
@@ -185,6 +194,7 @@ lock_init (struct lock *lock)
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  heap_init (&lock->waiters, waiter_has_lower_priority, NULL);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -201,16 +211,28 @@ lock_acquire (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
-  bool success = sema_try_down (&lock->semaphore);
   
-  if (!success)
+  if (!sema_try_down (&lock->semaphore))
     {
-      thread_current ()->blocking_lock = lock;
-      thread_donate_priority (thread_current ());
+      struct thread *cur = thread_current ();
+      enum intr_level old_level;
+
+      /* Wait, donating our priority down the chain of holders. */
+      old_level = intr_disable ();
+      cur->blocking_lock = lock;
+      heap_insert (&lock->waiters, &cur->waiter_elem);
+      thread_donate_priority (cur);
+      intr_set_level (old_level);
+
       sema_down (&lock->semaphore);
+
+      old_level = intr_disable ();
+      heap_remove (&lock->waiters, &cur->waiter_elem);
+      cur->blocking_lock = NULL;
+      intr_set_level (old_level);
     }
 
-  lock->holder = thread_current ();
+  lock_take (lock);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -229,10 +251,26 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    lock_take (lock);
   return success;
 }
 
+/* Makes the current thread the holder of LOCK, which it has just
+   downed, and takes the priority donated by LOCK's waiters. */
+static void
+lock_take (struct lock *lock)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  lock->holder = cur;
+  heap_insert (&cur->held_locks, &lock->held_elem);
+  if (!heap_empty (&lock->waiters))
+    thread_choose_priority (cur);
+  intr_set_level (old_level);
+}
+
 /* Releases LOCK, which must be owned by the current thread.
 
    An interrupt handler cannot acquire a lock, so it does not
@@ -244,9 +282,8 @@ lock_release (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
-  lock->holder = NULL;
   thread_remove_priority (thread_current (), lock);
-  thread_choose_priority (thread_current ());
+  lock->holder = NULL;
   
   sema_up (&lock->semaphore);
 }
@@ -262,6 +299,36 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+/* Returns the priority that LOCK's waiters donate to its holder,
+   or PRI_MIN - 1 if it has no waiters.  Must be called with
+   interrupts off. */
+int
+lock_donated_priority (const struct lock *lock)
+{
+  if (heap_empty (&lock->waiters))
+    return PRI_MIN - 1;
+  return heap_entry (heap_max (&lock->waiters),
+                     struct thread, waiter_elem)->priority;
+}
+
+/* Orders locks in a thread's held_locks by donated priority. */
+bool
+lock_has_lower_donation (const struct heap_elem *a,
+                         const struct heap_elem *b, void *aux UNUSED)
+{
+  return (lock_donated_priority (heap_entry (a, struct lock, held_elem))
+          < lock_donated_priority (heap_entry (b, struct lock, held_elem)));
+}
+
+/* Orders threads in a lock's waiters by priority. */
+static bool
+waiter_has_lower_priority (const struct heap_elem *a,
+                           const struct heap_elem *b, void *aux UNUSED)
+{
+  return (heap_entry (a, struct thread, waiter_elem)->priority
+          < heap_entry (b, struct thread, waiter_elem)->priority);
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
@@ -360,17 +427,225 @@ cond_broadcast (struct condition *cond, struct lock *lock)
     cond_signal (cond, lock);
 }
 
-/* Used to order donated priorities in descending order */
+/* Initializes spinlock SL.
+
+   Spinlocks protect data shared with interrupt handlers, or
+   sections too short to be worth sleeping over.  A spinlock
+   holder must not sleep.  Pintos runs on a single CPU, so no
+   other thread can hold the lock while we run with interrupts
+   off; acquiring one therefore just disables interrupts, and
+   the flag only catches misuse.  Spinlocks may be nested, if
+   they are released in the reverse order. */
+void
+spinlock_init (struct spinlock *sl)
+{
+  ASSERT (sl != NULL);
+
+  sl->locked = false;
+}
+
+/* Acquires SL.  May be called from an interrupt handler. */
+void
+spinlock_acquire (struct spinlock *sl)
+{
+  enum intr_level old_level;
+
+  ASSERT (sl != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (!sl->locked);
+  sl->locked = true;
+  sl->old_level = old_level;
+}
+
+/* Releases SL, which must be held, restoring the interrupt level
+   from before it was acquired. */
+void
+spinlock_release (struct spinlock *sl)
+{
+  ASSERT (sl != NULL);
+  ASSERT (sl->locked);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  sl->locked = false;
+  intr_set_level (sl->old_level);
+}
+
+/* Returns true if SL is held, false otherwise. */
 bool
-has_higher_priority_donation (const struct list_elem *elem_1,
-                              const struct list_elem *elem_2,
-                              void *aux UNUSED)
+spinlock_held (const struct spinlock *sl)
+{
+  ASSERT (sl != NULL);
+
+  return sl->locked;
+}
+
+/* Initializes RW.  Any number of readers may hold a reader-
+   writer lock at once, or a single writer.
+
+   A writer first takes RW's write_lock, which keeps out new
+   readers as well as other writers, and then waits for the
+   active readers to leave.  So once a writer is waiting, readers
+   arriving after it wait until it is done: writers are never
+   starved.  Threads waiting for the write_lock donate their
+   priority to the writer that holds it, as for any lock.  A
+   writer waiting for readers does not donate to them.
+
+   As a consequence, a thread that already holds RW for reading
+   must not acquire it for reading again, since that may wait
+   for a writer that is waiting for it. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->write_lock);
+  spinlock_init (&rw->guard);
+  rw->reader_cnt = 0;
+  rw->writer_waiting = false;
+  sema_init (&rw->readers_gone, 0);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds or
+   waits for it.  Must not be called within an interrupt
+   handler. */
+void
+rwlock_read_acquire (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->write_lock);
+  spinlock_acquire (&rw->guard);
+  rw->reader_cnt++;
+  spinlock_release (&rw->guard);
+  lock_release (&rw->write_lock);
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rwlock_read_release (struct rwlock *rw)
+{
+  bool wake_writer;
+
+  ASSERT (rw != NULL);
+
+  spinlock_acquire (&rw->guard);
+  ASSERT (rw->reader_cnt > 0);
+  wake_writer = --rw->reader_cnt == 0 && rw->writer_waiting;
+  if (wake_writer)
+    rw->writer_waiting = false;
+  spinlock_release (&rw->guard);
+
+  if (wake_writer)
+    sema_up (&rw->readers_gone);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  Must not be called within an interrupt handler. */
+void
+rwlock_write_acquire (struct rwlock *rw)
+{
+  bool wait;
+
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->write_lock);
+
+  spinlock_acquire (&rw->guard);
+  wait = rw->reader_cnt > 0;
+  rw->writer_waiting = wait;
+  spinlock_release (&rw->guard);
+
+  /* If the last reader leaves before we get here, it has already
+     upped the semaphore. */
+  if (wait)
+    sema_down (&rw->readers_gone);
+}
+
+/* Releases RW, which the current thread holds for writing. */
+void
+rwlock_write_release (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_release (&rw->write_lock);
+}
+
+/* Returns true if the current thread holds RW for writing. */
+bool
+rwlock_write_held_by_current_thread (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return lock_held_by_current_thread (&rw->write_lock);
+}
+
+/* Initializes SL.
+
+   A seqlock lets readers of a small value proceed without
+   taking any lock, at the cost of retrying if a writer got in
+   their way.  Readers use it like this:
+
+      unsigned seq;
+      do
+        {
+          seq = seqlock_read_begin (&sl);
+          ...copy the protected value...
+        }
+      while (seqlock_read_retry (&sl, seq));
+
+   Writers bracket their updates with seqlock_write_begin() and
+   seqlock_write_end(), which run with interrupts off.  Both
+   sides may be used from an interrupt handler, but a reader
+   must not run inside a write on the same thread. */
+void
+seqlock_init (struct seqlock *sl)
+{
+  ASSERT (sl != NULL);
+
+  sl->seq = 0;
+  spinlock_init (&sl->writer);
+}
+
+/* Starts a read of the value protected by SL.  Returns a
+   sequence number to pass to seqlock_read_retry(). */
+unsigned
+seqlock_read_begin (const struct seqlock *sl)
+{
+  unsigned seq = *(volatile const unsigned *) &sl->seq;
+
+  /* A write can only be in progress here if it is our own. */
+  ASSERT ((seq & 1) == 0);
+  barrier ();
+  return seq;
+}
+
+/* Ends a read of the value protected by SL, begun when
+   seqlock_read_begin() returned SEQ.  Returns true if a writer
+   changed the value meanwhile, so the read must be retried. */
+bool
+seqlock_read_retry (const struct seqlock *sl, unsigned seq)
+{
+  barrier ();
+  return *(volatile const unsigned *) &sl->seq != seq;
+}
+
+/* Starts a write of the value protected by SL. */
+void
+seqlock_write_begin (struct seqlock *sl)
+{
+  spinlock_acquire (&sl->writer);
+  sl->seq++;
+  barrier ();
+}
+
+/* Ends a write of the value protected by SL. */
+void
+seqlock_write_end (struct seqlock *sl)
 {
-  struct donated_priority *priority_1 = 
-      list_entry (elem_1, struct donated_priority, priority_elem);
-  struct donated_priority *priority_2 =
-      list_entry (elem_2, struct donated_priority, priority_elem);
-  return (priority_1->priority > priority_2->priority);
+  barrier ();
+  sl->seq++;
+  spinlock_release (&sl->writer);
 }
 
 /* Used to find the maximum in a list of semaphore_elems. */
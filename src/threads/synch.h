@@ -1,8 +1,10 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include "threads/interrupt.h"
 
 /* A counting semaphore. */
 struct semaphore 
@@ -22,15 +24,9 @@ struct lock
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
-  };
-
-struct donated_priority
-  {
-   struct lock *blocking_lock;     /* The lock causing priority to be 
-                                      donated. */
-   int priority;                   /* The priority donated. */
-   struct list_elem priority_elem; /* Element in a thread's donated
-                                      priority list.*/
+    struct heap waiters;        /* Threads waiting for the lock, by
+                                   priority. */
+    struct heap_elem held_elem; /* Element in holder's held_locks. */
   };
 
 void lock_init (struct lock *);
@@ -38,6 +34,9 @@ void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+int lock_donated_priority (const struct lock *);
+bool lock_has_lower_donation (const struct heap_elem *a,
+                              const struct heap_elem *b, void *aux);
 
 /* Condition variable. */
 struct condition 
@@ -50,10 +49,54 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Spinlock.  Held only briefly, never across a sleep.  On our
+   single CPU, holding one amounts to running with interrupts
+   off. */
+struct spinlock
+  {
+    bool locked;                /* True while held. */
+    enum intr_level old_level;  /* Interrupt level to restore. */
+  };
+
+void spinlock_init (struct spinlock *);
+void spinlock_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+bool spinlock_held (const struct spinlock *);
+
+/* Reader-writer lock, preferring writers. */
+struct rwlock
+  {
+    struct lock write_lock;     /* Held by the writer, and briefly by
+                                   each entering reader. */
+    struct spinlock guard;      /* Protects the members below. */
+    int reader_cnt;             /* Number of active readers. */
+    bool writer_waiting;        /* Writer waiting for readers to leave? */
+    struct semaphore readers_gone; /* Upped for a waiting writer. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_read_acquire (struct rwlock *);
+void rwlock_read_release (struct rwlock *);
+void rwlock_write_acquire (struct rwlock *);
+void rwlock_write_release (struct rwlock *);
+bool rwlock_write_held_by_current_thread (const struct rwlock *);
+
+/* Sequence lock, for small values that are read far more often
+   than written. */
+struct seqlock
+  {
+    unsigned seq;               /* Odd while a write is in progress. */
+    struct spinlock writer;     /* Serializes writers. */
+  };
+
+void seqlock_init (struct seqlock *);
+unsigned seqlock_read_begin (const struct seqlock *);
+bool seqlock_read_retry (const struct seqlock *, unsigned seq);
+void seqlock_write_begin (struct seqlock *);
+void seqlock_write_end (struct seqlock *);
+
 bool sema_elem_has_lower_priority (const struct list_elem *elem_1,
                                    const struct list_elem *elem_2, void *aux);
-bool has_higher_priority_donation (const struct list_elem *elem_1,
-                                   const struct list_elem *elem_2, void *aux);
 
 /* Optimization barrier.
 
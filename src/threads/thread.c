@@ -10,13 +10,13 @@
 #include "threads/intr-stubs.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
 #ifdef USERPROG
 #include "filesys/file.h"
-#include "filesys/filesys.h"
 #include "userprog/process.h"
 #include "vm/page.h"
 #include "vm/swap.h"
@@ -27,25 +27,33 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-/* This list is ordered by priority */
-static struct list ready_list;
+/* Lists of processes in THREAD_READY state, that is, processes
+   that are ready to run but not actually running, one list per
+   priority.  Each list is in FIFO order. */
+static struct list ready_queues[PRI_MAX + 1];
 
-/* Number of processes on the ready list. */
+/* Bit P is set if and only if ready_queues[P] is not empty, so
+   that the highest-priority ready thread is found in O(1). */
+static uint64_t ready_mask;
+#if PRI_MAX - PRI_MIN >= 64
+#error ready_mask needs one bit per priority
+#endif
+
+/* Number of processes ready to run. */
 static int ready_count;
 
+/* Fair scheduler only; the ready queues above stay empty. */
+static struct heap fair_queue;  /* Ready processes, least vruntime
+                                   at the top. */
+static int64_t min_vruntime;    /* Least vruntime of any ready or
+                                   running process.  Never
+                                   decreases. */
+static int total_weight;        /* Sum of ready processes' weights. */
+
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* List of processes which are sleeping after the call to
-   timer_sleep in timer. */
-static struct list sleeping_list;
-
-/* Semaphore for accessing the sleeping_list */
-static struct semaphore sleep_sema;
-
 /* Idle thread. */
 static struct thread *idle_thread;
 
@@ -55,6 +63,30 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* Pages of exited threads, kept for reuse by thread_create() so
+   that spawning threads does not churn the kernel pool.  A
+   cached page is not zeroed again: init_thread() clears the
+   struct thread, and the rest is stack.  When the cache is full,
+   the pages of further exiting threads go straight back to
+   palloc.  When memory is short, palloc takes the cached pages
+   back with thread_take_cached_pages().  The cache is protected
+   by disabling interrupts, because thread_schedule_tail() adds
+   to it with interrupts off. */
+#define THREAD_PAGE_CACHE_CNT 8
+struct thread_page
+  {
+    struct thread_page *next;   /* Next page in chain. */
+  };
+static struct thread_page *cached_pages;  /* Pages ready for reuse. */
+static size_t cached_page_cnt;            /* Length of CACHED_PAGES. */
+
+/* Caches of per-process bookkeeping structures. */
+static struct slab_cache child_cache;
+#ifdef USERPROG
+static struct slab_cache open_file_cache;
+#endif
+static struct slab_cache mapped_file_cache;
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -74,14 +106,69 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 static int load_avg;            /* System load average. In fixed-point
                                    arithmetic. */
 
-/* True only when thread_wake_up is running. */
-static bool wake_up_running;
+/* The BSD scheduler decays every thread's recent_cpu once per
+   second, but the timer interrupt only records the decay
+   coefficient and applies it to the running thread, so that its
+   work does not grow with the number of threads.  Other threads
+   are caught up lazily, using the coefficients recorded here:
+   blocked threads when they are unblocked, and ready threads when
+   the scheduler comes to pick them.  The coefficient of decay
+   number E is decay_table[E % DECAY_TABLE_SIZE].  Each decay
+   multiplies recent_cpu by less than 1, so a thread that missed
+   more decays than the table holds has its recent_cpu dropped to
+   zero before the ones in the table are applied. */
+#define DECAY_TABLE_SIZE 64
+static int decay_table[DECAY_TABLE_SIZE];
+static int64_t decay_epoch;     /* Number of decays so far. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* The fair scheduler runs the ready thread with the least virtual
+   runtime, which advances as a thread runs, more slowly the
+   greater its weight.  Over time each thread thus gets CPU time
+   in proportion to its weight.  Time slices are carved out of
+   FAIR_LATENCY ticks in the same proportions, so that every ready
+   thread runs within about FAIR_LATENCY ticks, unless there are
+   so many that slices would drop below FAIR_MIN_SLICE.
+
+   A thread that wakes up from a sleep has its vruntime raised
+   to at most FAIR_SLEEPER_CREDIT below the least vruntime, so
+   that interactive threads run promptly after waking, but cannot
+   bank their sleep time to monopolize the CPU later.  A new
+   thread starts at the least vruntime.
+
+   A nice-0 thread's vruntime advances by NICE_0_WEIGHT per tick;
+   each step in nice changes the weight by about 25%. */
+#define NICE_0_WEIGHT 1024
+#define FAIR_LATENCY 20         /* Target scheduling latency, in ticks. */
+#define FAIR_MIN_SLICE 2        /* Minimum time slice, in ticks. */
+#define FAIR_WAKEUP_GRAN NICE_0_WEIGHT  /* vruntime lead over a ready
+                                           thread that preempts. */
+#define FAIR_SLEEPER_CREDIT (FAIR_LATENCY / 2 * NICE_0_WEIGHT)
+
+/* Weight for each nice value from -20 to 20. */
+static const int nice_weights[41] =
+  {
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */  9548,  7620,  6100,  4904,  3906,
+    /*  -5 */  3121,  2501,  1991,  1586,  1277,
+    /*   0 */  1024,   820,   655,   526,   423,
+    /*   5 */   335,   272,   215,   172,   137,
+    /*  10 */   110,    87,    70,    56,    45,
+    /*  15 */    36,    29,    23,    18,    15,
+    /*  20 */    12,
+  };
+
+static unsigned time_slice;     /* # of timer ticks in current slice. */
+
+/* If true, use the fair-share scheduler.
+   Controlled by kernel command-line option "-o fair". */
+bool thread_fair;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -91,18 +178,27 @@ static void init_thread (struct thread *, const char *name, int priority,
     int recent_cpu, int nice);
 static bool is_thread (struct thread *) UNUSED;
 static int thread_calculate_priority (struct thread *);
-static void thread_recalculate_priority (struct thread *,
-    void *aux UNUSED);
 static void thread_recalculate_load_avg (void);
-static void thread_recalculate_recent_cpu (struct thread *,
-    void *aux UNUSED);
+static void thread_decay_recent_cpu (void);
+static void thread_catch_up_recent_cpu (struct thread *);
+static struct thread *mlfqs_first (void);
 static void *alloc_frame (struct thread *, size_t size);
+static struct thread *alloc_thread_page (void);
+static void release_thread_page (struct thread *);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
 
-static bool wakes_up_earlier (const struct list_elem *elem_1,
-    const struct list_elem *elem_2, void *aux);
+static timer_callout_func wake_up;
+
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static int ready_max_priority (void);
+static void thread_update_priority (struct thread *, int priority);
+static heap_less_func has_greater_vruntime;
+static struct thread *fair_first (void);
+static void fair_update_min_vruntime (void);
+static unsigned fair_slice (const struct thread *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -120,17 +216,32 @@ static bool wakes_up_earlier (const struct list_elem *elem_1,
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = PRI_MIN; i <= PRI_MAX; i++)
+    list_init (&ready_queues[i]);
   list_init (&all_list);
-  list_init (&sleeping_list);
 
+  ready_mask = 0;
   ready_count = 0;
+  heap_init (&fair_queue, has_greater_vruntime, NULL);
+  min_vruntime = 0;
+  total_weight = 0;
+  time_slice = TIME_SLICE;
+
 
-  sema_init (&sleep_sema, 1);
-  wake_up_running = false;
+  slab_cache_init (&child_cache, "child", sizeof (struct child),
+                   __alignof__ (struct child), NULL);
+#ifdef USERPROG
+  slab_cache_init (&open_file_cache, "open_file", sizeof (struct open_file),
+                   __alignof__ (struct open_file), NULL);
+#endif
+  slab_cache_init (&mapped_file_cache, "mapped_file",
+                   sizeof (struct mapped_file),
+                   __alignof__ (struct mapped_file), NULL);
 
   /* Initialised to 0, but needs to be converted to fixed-point arithmetic. */
   load_avg = FP_TO_FIXED_POINT(0);
@@ -187,21 +298,34 @@ thread_tick (void)
     if (t != idle_thread)
       t->recent_cpu = FP_ADD_INT(t->recent_cpu, 1);
 
-    /* Recalculate recent_cpu for every thread and system load average
-       once per second. */
+    /* Recalculate system load average and decay recent_cpu once per
+       second. */
     if (ticks % TIMER_FREQ == 0)
       {
         thread_recalculate_load_avg ();
-        thread_foreach (&thread_recalculate_recent_cpu, NULL);
+        thread_decay_recent_cpu ();
       }
     
-    /* Recalculate priorities of all the threads every fourth clock tick. */
-    if (ticks % 4 == 0)
-      thread_foreach (&thread_recalculate_priority, NULL);
+    /* Recalculate the running thread's priority every fourth clock
+       tick.  No other thread's recent_cpu changed since its last
+       decay, so neither did its priority. */
+    if (ticks % 4 == 0 && t != idle_thread)
+      {
+        thread_update_priority (t, thread_calculate_priority (t));
+        if (!is_highest_priority ())
+          intr_yield_on_return ();
+      }
   }
 
+  /* Charge the running thread's virtual runtime for the tick. */
+  if (thread_fair && t != idle_thread)
+    {
+      t->vruntime += NICE_0_WEIGHT * NICE_0_WEIGHT / t->weight;
+      fair_update_min_vruntime ();
+    }
+
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (++thread_ticks >= time_slice)
     intr_yield_on_return ();
 }
 
@@ -242,13 +366,13 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
   
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = alloc_thread_page ();
   if (t == NULL)
     return TID_ERROR;
 
 
   /* Initialize thread. */
-  init_thread (t, name, priority, thread_get_recent_cpu (),
+  init_thread (t, name, priority, thread_current ()->recent_cpu,
                thread_get_nice ());
 
   
@@ -330,14 +454,24 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_insert_ordered (&ready_list, &t->elem, &has_higher_priority, NULL);
-  ready_count++;
+  if (thread_mlfqs)
+    {
+      thread_catch_up_recent_cpu (t);
+      t->priority = thread_calculate_priority (t);
+    }
+  else if (thread_fair)
+    {
+      int64_t floor = min_vruntime - FAIR_SLEEPER_CREDIT;
+      if (t->vruntime < floor)
+        t->vruntime = floor;
+    }
+  ready_push (t);
   t->status = THREAD_READY;
-  t->blocking_lock = NULL;
   intr_set_level (old_level);
 }
 
-/* Puts threads to sleep (blocks it) for at least the given number of ticks */
+/* Puts the current thread to sleep (blocks it) until timer tick
+   TICKS_WHEN_AWAKE.  The timer interrupt wakes it up. */
 void
 thread_sleep (int64_t ticks_when_awake)
 {
@@ -345,53 +479,19 @@ thread_sleep (int64_t ticks_when_awake)
 
     ASSERT (cur->status == THREAD_RUNNING);
 
-    cur->ticks_when_awake = ticks_when_awake;
-    
-    sema_down (&sleep_sema);
-    /* We want to insert threads into sleeping_list ordered. */
-    list_insert_ordered (&sleeping_list, &cur->sleep_elem,
-                         &wakes_up_earlier, NULL);
-    sema_up (&sleep_sema);
+    timer_callout_add (&cur->sleep_callout, ticks_when_awake);
     
     /* Put the thread to sleep */
     sema_down (&cur->sleep_sema);
 }
 
-/* Wakes up all the sleeping threads that can be awoken at this time
-   (in terms of total timer ticks). */
-void
-thread_wake_up (void)
-{
-  int ticks = timer_ticks();
-
-  sema_down (&sleep_sema);
-  
-  struct list_elem *e;
-  for (e = list_begin (&sleeping_list); e != list_end (&sleeping_list);
-       e = list_next (e))
-    {
-      struct thread *t = list_entry (e, struct thread, sleep_elem);
-
-      /* If the first thread can't wake up now neither can any other. */
-      if (t->ticks_when_awake > ticks)
-        break;
-
-      list_remove (&t->sleep_elem);
-      sema_up (&t->sleep_sema);
-    }
-  
-  sema_up (&sleep_sema);
-}
-
-/* Returns true if the thread in elem_1 should wake up earlier than
-   the thread in elem_2. */
-bool
-wakes_up_earlier (const struct list_elem *elem_1,
-    const struct list_elem *elem_2, void *aux UNUSED)
+/* Wakes up sleeping thread T_.  A timer callout, so it runs in
+   the timer interrupt. */
+static void
+wake_up (void *t_)
 {
-  struct thread *thread_1 = list_entry (elem_1, struct thread, sleep_elem);
-  struct thread *thread_2 = list_entry (elem_2, struct thread, sleep_elem);
-  return thread_1->ticks_when_awake < thread_2->ticks_when_awake;
+  struct thread *t = t_;
+  sema_up (&t->sleep_sema);
 }
 
 /* Returns the name of the running thread. */
@@ -444,18 +544,14 @@ thread_exit (void)
       struct mapped_file *mf = list_entry (e, struct mapped_file, elem);
 
       page_write_to_mapped_file (mf->file, mf->addr, mf->size);
-      filesys_lock_acquire ();
       file_close (mf->file);
-      filesys_lock_release ();
       
-      free (mf);
+      slab_free (&mapped_file_cache, mf);
     }
 
 #ifdef USERPROG
   /* Re-enable writing to this process's executable file. */
-  filesys_lock_acquire ();
   file_close (thread_current ()->executable_file);
-  filesys_lock_release ();
 
   /* Remove and free all pages used by the thread. */
   /*struct hash_iterator i;
@@ -486,9 +582,7 @@ thread_exit (void)
        e = list_next (e))
     {
       struct open_file *open_file = list_entry (e, struct open_file, elem);
-      filesys_lock_acquire ();
       file_close (open_file->file);
-      filesys_lock_release ();
     }
 
   /* Free CHILDREN and OPEN_FILES. */
@@ -497,7 +591,7 @@ thread_exit (void)
       e = list_pop_front (&current->children);
       struct child *child = list_entry (e, struct child, elem);
       if (sema_try_down (&child->free_sema))
-        free (child);
+        thread_child_free (child);
       else
         sema_up (&child->free_sema);
     }
@@ -505,16 +599,17 @@ thread_exit (void)
     {
       e = list_pop_front (&current->open_files);
       struct open_file *open_file = list_entry (e, struct open_file, elem);
-      free (open_file);
+      slab_free (&open_file_cache, open_file);
     }
 
   palloc_free_page (current->args_copy);
 
-  filesys_lock_release ();
-
   process_exit ();
 #endif
 
+  /* Give back the free pages cached for us by palloc. */
+  palloc_drain_magazine (thread_current ());
+
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
@@ -537,11 +632,7 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-    {
-      list_insert_ordered (&ready_list, &cur->elem, &has_higher_priority,
-                           NULL);
-      ready_count++;
-    }
+    ready_push (cur);
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
@@ -551,7 +642,12 @@ thread_yield (void)
 void
 yield_if_necessary (void)
 {
-  if (!wake_up_running && !is_highest_priority ())
+  if (is_highest_priority ())
+    return;
+
+  if (intr_context ())
+    intr_yield_on_return ();
+  else
     thread_yield ();
 }
 
@@ -588,103 +684,74 @@ thread_set_priority (int new_priority)
   yield_if_necessary ();
 }
 
-/* Chooses the priority field for a specified thread. */
+/* Sets T's priority to the higher of the priority it set itself
+   and the highest priority donated through the locks it holds. */
 void
 thread_choose_priority (struct thread *t)
 {
-  t->priority = t->self_set_priority;
+  int priority = t->self_set_priority;
+  enum intr_level old_level;
+
+  if (thread_mlfqs)
+    return;
 
-  sema_down (&t->priority_sema);
-  if (!list_empty (&t->donated_priorities))
+  old_level = intr_disable ();
+  if (!heap_empty (&t->held_locks))
     {
-      struct donated_priority *d =
-          list_entry (list_front (&t->donated_priorities),
-                      struct donated_priority, priority_elem);
+      struct lock *l = heap_entry (heap_max (&t->held_locks),
+                                   struct lock, held_elem);
+      int donated = lock_donated_priority (l);
 
-      if (d->priority > t->priority)
-        t->priority = d->priority;
-  }
-  sema_up (&t->priority_sema);
+      if (donated > priority)
+        priority = donated;
+    }
+  thread_update_priority (t, priority);
+  intr_set_level (old_level);
 }
 
-/* Called when a thread cannot acquire a lock, donates priority to the lock
-   owner and threads causing that to block if necessary.*/
+/* Called when thread T has started waiting for its blocking_lock,
+   or its priority has risen while waiting.  Donates T's priority
+   to the holder of the lock, and on down the chain of holders
+   blocked on further locks, stopping as soon as a holder already
+   has at least that priority.  Takes O(1) per thread in the
+   chain.  Must be called with interrupts off. */
 void       
-thread_donate_priority (struct thread *donating_thread)
+thread_donate_priority (struct thread *t)
 {
-  return;
+  ASSERT (intr_get_level () == INTR_OFF);
 
-  if (donating_thread->blocking_lock == NULL)
+  if (thread_mlfqs)
     return;
 
-  struct thread *receiving_thread = donating_thread->blocking_lock->holder;
-  struct list_elem *e;
-  bool priority_in_list = false;
+  while (t->blocking_lock != NULL)
+    {
+      struct lock *lock = t->blocking_lock;
+      struct thread *holder = lock->holder;
 
-  sema_down (&receiving_thread->priority_sema);
+      heap_increased (&lock->waiters, &t->waiter_elem);
+      if (holder == NULL)
+        break;
 
-  for (e = list_begin (&receiving_thread->donated_priorities);
-       e != list_end (&receiving_thread->donated_priorities);
-       e = list_next (e))
-    {
-      struct donated_priority *d = list_entry (e, struct donated_priority,
-                                               priority_elem);
+      heap_increased (&holder->held_locks, &lock->held_elem);
+      if (holder->priority >= t->priority)
+        break;
 
-      if (d->blocking_lock == donating_thread->blocking_lock)
-        {
-          priority_in_list = true;
-          if (donating_thread->priority > d->priority)
-            {
-              d->priority = donating_thread->priority;
-              sema_up (&receiving_thread->priority_sema);
-              break; 
-            }
-          sema_up (&receiving_thread->priority_sema);
-          return;       
-        }             
+      thread_update_priority (holder, t->priority);
+      t = holder;
     }
-  
-  if (!priority_in_list)
-    {
-      struct donated_priority *donation =
-          malloc (sizeof (struct donated_priority));
-      if (malloc == NULL) 
-        thread_exit ();
-      donation->priority = donating_thread->priority;
-      donation->blocking_lock = donating_thread->blocking_lock;
-      list_insert_ordered (&receiving_thread->donated_priorities,
-                           &donation->priority_elem,
-                           &has_higher_priority_donation, NULL);
-      sema_up (&receiving_thread->priority_sema);
-    }
-
-  thread_choose_priority(receiving_thread);
-  thread_donate_priority(receiving_thread);
 }
 
-/* Removes a donated priority from a thread (if it exists) for the
-   corresponding lock. Called when a thread releases a lock. */
+/* Removes lock L, which T is releasing, from T's held locks, and
+   gives up the priority donated through it. */
 void
 thread_remove_priority (struct thread *t, struct lock *l)
 {  
-  struct list_elem *e;
-         
-  for (e = list_begin (&t->donated_priorities);
-       e != list_end (&t->donated_priorities);        
-       e = list_next (e))
-    {
-      struct donated_priority *d =
-          list_entry (e, struct donated_priority, priority_elem);
-      
-      if (d->blocking_lock == l)
-        {
-          sema_down (&t->priority_sema);
-          list_remove (e);
-          sema_up (&t->priority_sema);
-          free (d);
-          return;
-        }
-    }
+  enum intr_level old_level = intr_disable ();
+
+  heap_remove (&t->held_locks, &l->held_elem);
+  thread_choose_priority (t);
+
+  intr_set_level (old_level);
 }
 
 /* Returns the current thread's priority. */
@@ -706,16 +773,14 @@ thread_calculate_priority (struct thread *t)
   /* Priority -= nice * 2 */
   priority = FP_SUBTRACT(priority, 
                          FP_MULTIPLY_INT(FP_TO_FIXED_POINT(t->nice), 2));
-  /* Return priority rounded down to the nearest integer. */
-  return FP_TO_INT_TRUNCATE(priority);
-}
-
-/* Calculates and sets a new priority for the given thread.
-   Used by the BSD scheduler. */
-void
-thread_recalculate_priority (struct thread *t, void *aux UNUSED)
-{
-  t->priority = thread_calculate_priority (t);
+  /* Round priority down to the nearest integer and clamp it to the
+     valid range. */
+  priority = FP_TO_INT_TRUNCATE(priority);
+  if (priority < PRI_MIN)
+    return PRI_MIN;
+  if (priority > PRI_MAX)
+    return PRI_MAX;
+  return priority;
 }
 
 /* Sets the current thread's nice value to new_nice. */
@@ -726,7 +791,10 @@ thread_set_nice (int new_nice)
 
   struct thread *cur = thread_current ();
   cur->nice = new_nice;
-  cur->priority = thread_calculate_priority (cur);
+  if (thread_fair)
+    cur->weight = nice_weights[new_nice + 20];
+  else
+    thread_update_priority (cur, thread_calculate_priority (cur));
   
   /* Yield if the running thread no longer has the highest priority. */
   yield_if_necessary ();
@@ -777,22 +845,48 @@ thread_get_recent_cpu (void)
   return FP_TO_INT_ROUND(FP_MULTIPLY_INT(thread_current ()->recent_cpu, 100));
 }
 
-/* Recalculates and sets a new value for recent_cpu of the given thread. */
-void
-thread_recalculate_recent_cpu (struct thread *t, void *aux UNUSED)
+/* Performs the once-per-second decay of recent_cpu: records the
+   decay coefficient and applies it to the running thread.  Other
+   threads are caught up later; see decay_table. */
+static void
+thread_decay_recent_cpu (void)
 {
+  struct thread *cur = running_thread ();
+
   /* Coefficient = load_avg * 2 */
   int coefficient = FP_MULTIPLY_INT(load_avg, 2);
   /* Coefficient = (load_avg * 2) / (load_avg * 2 + 1) */
   coefficient = FP_DIVIDE(coefficient, FP_ADD_INT(coefficient, 1));
 
-  int recent_cpu = t->recent_cpu;
-  /* Recent_cpu = recent_cpu * coefficient */
-  recent_cpu = FP_MULTIPLY(recent_cpu, coefficient);
-  /* Recent_cpu += nice */
-  recent_cpu = FP_ADD_INT(recent_cpu, t->nice);
+  decay_epoch++;
+  decay_table[decay_epoch % DECAY_TABLE_SIZE] = coefficient;
 
-  t->recent_cpu = recent_cpu;
+  if (cur != idle_thread)
+    thread_catch_up_recent_cpu (cur);
+}
+
+/* Applies to T's recent_cpu the decays it has missed since it was
+   last brought up to date.  Must be called with interrupts off. */
+static void
+thread_catch_up_recent_cpu (struct thread *t)
+{
+  int64_t epoch = t->cpu_epoch;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (epoch < decay_epoch - DECAY_TABLE_SIZE)
+    {
+      t->recent_cpu = 0;
+      epoch = decay_epoch - DECAY_TABLE_SIZE;
+    }
+  while (epoch < decay_epoch)
+    {
+      int coefficient = decay_table[++epoch % DECAY_TABLE_SIZE];
+      /* Recent_cpu = recent_cpu * coefficient + nice */
+      t->recent_cpu = FP_ADD_INT(FP_MULTIPLY(t->recent_cpu, coefficient),
+                                 t->nice);
+    }
+  t->cpu_epoch = decay_epoch;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -803,7 +897,10 @@ thread_recalculate_recent_cpu (struct thread *t, void *aux UNUSED)
    to it to enable thread_start() to continue, and immediately
    blocks.  After that, the idle thread never appears in the
    ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   special case when the ready list is empty.
+
+   Before halting, the idle thread uses the spare time to zero
+   free pages for later PAL_ZERO allocations. */
 static void
 idle (void *idle_started_ UNUSED) 
 {
@@ -813,10 +910,17 @@ idle (void *idle_started_ UNUSED)
 
   for (;;) 
     {
+      /* Zero free pages until someone else can run. */
+      while (ready_count == 0 && palloc_zero_idle ())
+        continue;
+
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
 
+      /* Stop the periodic timer interrupt if nothing is due. */
+      timer_idle_sleep ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -830,6 +934,10 @@ idle (void *idle_started_ UNUSED)
          See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
          7.11.1 "HLT Instruction". */
       asm volatile ("sti; hlt" : : : "memory");
+
+      intr_disable ();
+      timer_idle_wake ();
+      intr_enable ();
     }
 }
 
@@ -887,12 +995,15 @@ init_thread (struct thread *t, const char *name, int priority,
   /* Recent_cpu and nice used only by BSD scheduler but they can be here.
      They will be initialised and kept at 0. */
   t->recent_cpu = recent_cpu;
+  t->cpu_epoch = decay_epoch;
   t->nice = nice;
+  t->weight = nice_weights[nice + 20];
+  t->vruntime = min_vruntime;
   t->magic = THREAD_MAGIC;
  
   sema_init (&t->sleep_sema, 0);
-  list_init (&t->donated_priorities);
-  sema_init (&t->priority_sema, 1);
+  timer_callout_init (&t->sleep_callout, wake_up, t);
+  heap_init (&t->held_locks, lock_has_lower_donation, NULL);
 
 #ifdef USERPROG
   /* Initialize lists used in user threads. */
@@ -907,8 +1018,8 @@ init_thread (struct thread *t, const char *name, int priority,
   intr_set_level (old_level);
 }
 
-/* Allocates a SIZE-byte frame at the top of thread T's stack and
-   returns a pointer to the frame's base. */
+/* Allocates a zeroed SIZE-byte frame at the top of thread T's
+   stack and returns a pointer to the frame's base. */
 static void *
 alloc_frame (struct thread *t, size_t size) 
 {
@@ -917,9 +1028,73 @@ alloc_frame (struct thread *t, size_t size)
   ASSERT (size % sizeof (uint32_t) == 0);
 
   t->stack -= size;
+  memset (t->stack, 0, size);
   return t->stack;
 }
 
+/* Returns a page for a new thread, reusing an exited thread's
+   page if one is cached.  Returns a null pointer if no page is
+   available.  The page's contents are arbitrary. */
+static struct thread *
+alloc_thread_page (void)
+{
+  struct thread_page *page;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  page = cached_pages;
+  if (page != NULL)
+    {
+      cached_pages = page->next;
+      cached_page_cnt--;
+    }
+  intr_set_level (old_level);
+
+  if (page == NULL)
+    page = palloc_get_page (0);
+  return (struct thread *) page;
+}
+
+/* Empties the cache of exited threads' pages and returns its
+   pages, linked through their first words, for palloc to reclaim
+   when memory is short.  Must be called with interrupts off. */
+void *
+thread_take_cached_pages (void)
+{
+  struct thread_page *pages = cached_pages;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  cached_pages = NULL;
+  cached_page_cnt = 0;
+  return pages;
+}
+
+/* Releases dying thread T's page, caching it for reuse if there
+   is room and freeing it otherwise.  Called with interrupts off,
+   from thread_schedule_tail(), so palloc_free_page() updates the
+   pool without taking its lock, as it always has here; nothing
+   in this path may sleep. */
+static void
+release_thread_page (struct thread *t)
+{
+  struct thread_page *page = (struct thread_page *) t;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Keep a stale pointer to T from passing is_thread(). */
+  t->magic = 0;
+
+  if (cached_page_cnt < THREAD_PAGE_CACHE_CNT)
+    {
+      page->next = cached_pages;
+      cached_pages = page;
+      cached_page_cnt++;
+    }
+  else
+    palloc_free_page (page);
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
@@ -928,13 +1103,179 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  struct thread *t;
+
+  if (ready_count == 0)
     return idle_thread;
+
+  if (thread_fair)
+    t = fair_first ();
+  else if (thread_mlfqs)
+    t = mlfqs_first ();
   else
-  {
-    ready_count--;
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
-  }
+    t = list_entry (list_front (&ready_queues[ready_max_priority ()]),
+                    struct thread, elem);
+  ready_remove (t);
+  return t;
+}
+
+/* Returns the ready thread that the BSD scheduler should run
+   next, which must exist.  Ready threads' priorities may be stale
+   because of decays they have not been caught up on, so the
+   first thread of the highest-priority queue is caught up, and
+   moved to the queue for its new priority if that changed, until
+   the first thread is up to date.  Each ready thread is caught up
+   at most once per decay, so this costs O(1) per thread per
+   second, amortized. */
+static struct thread *
+mlfqs_first (void)
+{
+  for (;;)
+    {
+      int priority = ready_max_priority ();
+      struct thread *t = list_entry (list_front (&ready_queues[priority]),
+                                     struct thread, elem);
+
+      if (t->cpu_epoch == decay_epoch)
+        return t;
+      thread_catch_up_recent_cpu (t);
+      priority = thread_calculate_priority (t);
+      if (priority == t->priority)
+        return t;
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
+}
+
+/* Adds ready thread T to the back of the run queue for its
+   priority.  Must be called with interrupts off. */
+static void
+ready_push (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  if (thread_fair)
+    {
+      heap_insert (&fair_queue, &t->fair_elem);
+      total_weight += t->weight;
+    }
+  else
+    {
+      list_push_back (&ready_queues[t->priority], &t->elem);
+      ready_mask |= (uint64_t) 1 << t->priority;
+    }
+  ready_count++;
+}
+
+/* Removes ready thread T from its run queue.  Must be called with
+   interrupts off. */
+static void
+ready_remove (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_fair)
+    {
+      heap_remove (&fair_queue, &t->fair_elem);
+      total_weight -= t->weight;
+    }
+  else
+    {
+      list_remove (&t->elem);
+      if (list_empty (&ready_queues[t->priority]))
+        ready_mask &= ~((uint64_t) 1 << t->priority);
+    }
+  ready_count--;
+}
+
+/* Returns the highest priority of any ready thread.  There must
+   be at least one. */
+static int
+ready_max_priority (void)
+{
+  uint32_t high = ready_mask >> 32;
+  uint32_t low = ready_mask;
+
+  ASSERT (ready_mask != 0);
+  return high != 0 ? 63 - __builtin_clz (high) : 31 - __builtin_clz (low);
+}
+
+/* Sets T's priority to PRIORITY, moving T to the matching run
+   queue if it is ready. */
+static void
+thread_update_priority (struct thread *t, int priority)
+{
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  old_level = intr_disable ();
+  if (t->status == THREAD_READY && t != idle_thread
+      && t->priority != priority && !thread_fair)
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
+  else
+    t->priority = priority;
+  intr_set_level (old_level);
+}
+
+/* Orders threads in the fair scheduler's run queue so that the
+   one with the least vruntime is the heap's maximum. */
+static bool
+has_greater_vruntime (const struct heap_elem *a, const struct heap_elem *b,
+                      void *aux UNUSED)
+{
+  return (heap_entry (a, struct thread, fair_elem)->vruntime
+          > heap_entry (b, struct thread, fair_elem)->vruntime);
+}
+
+/* Returns the ready thread with the least vruntime.  There must
+   be at least one. */
+static struct thread *
+fair_first (void)
+{
+  return heap_entry (heap_max (&fair_queue), struct thread, fair_elem);
+}
+
+/* Advances min_vruntime to the least vruntime of the running
+   thread and the ready threads, if that is greater. */
+static void
+fair_update_min_vruntime (void)
+{
+  struct thread *cur = running_thread ();
+  int64_t least = min_vruntime;
+  bool found = false;
+
+  if (cur != idle_thread && cur->status == THREAD_RUNNING)
+    {
+      least = cur->vruntime;
+      found = true;
+    }
+  if (ready_count > 0)
+    {
+      int64_t first = fair_first ()->vruntime;
+      if (!found || first < least)
+        least = first;
+    }
+  if (least > min_vruntime)
+    min_vruntime = least;
+}
+
+/* Returns the time slice for T, just taken off the run queue: T's
+   share by weight of FAIR_LATENCY, but at least FAIR_MIN_SLICE
+   ticks. */
+static unsigned
+fair_slice (const struct thread *t)
+{
+  int total = total_weight + t->weight;
+  unsigned slice = FAIR_LATENCY * t->weight / total;
+
+  return slice > FAIR_MIN_SLICE ? slice : FAIR_MIN_SLICE;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -965,6 +1306,11 @@ thread_schedule_tail (struct thread *prev)
 
   /* Start new time slice. */
   thread_ticks = 0;
+  if (thread_fair && cur != idle_thread)
+    {
+      fair_update_min_vruntime ();
+      time_slice = fair_slice (cur);
+    }
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -979,7 +1325,7 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      release_thread_page (prev);
     }
 }
 
@@ -993,11 +1339,6 @@ thread_schedule_tail (struct thread *prev)
 static void
 schedule (void) 
 {
-  /* Wake up any threads that can be woken up. */
-  wake_up_running = true;
-  thread_wake_up ();
-  wake_up_running = false;
-
   struct thread *cur = running_thread ();
   struct thread *next = next_thread_to_run ();
   struct thread *prev = NULL;
@@ -1006,6 +1347,11 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  /* An interrupt woke a thread while the idle thread was halted:
+     restart the periodic timer interrupt before it runs. */
+  if (cur == idle_thread && next != idle_thread)
+    timer_idle_wake ();
+
   if (cur != next)
     prev = switch_threads (cur, next);
   thread_schedule_tail (prev);
@@ -1030,16 +1376,42 @@ allocate_tid (void)
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 
-/* Determines whether or not the running thread has the highest priority. */
+/* Determines whether or not the running thread has the highest priority.
+   Under the fair scheduler, whether no ready thread trails the
+   running thread's vruntime by more than FAIR_WAKEUP_GRAN. */
 bool
 is_highest_priority (void)
 {
-  if (list_empty (&ready_list))
-    return true;
-  
-  struct thread *first =
-      list_entry (list_front (&ready_list), struct thread, elem);
-  return (thread_current ()->priority == first->priority);
+  enum intr_level old_level = intr_disable ();
+  struct thread *cur = thread_current ();
+  bool highest;
+
+  if (ready_count == 0)
+    highest = true;
+  else if (thread_fair)
+    highest = (cur != idle_thread
+               && cur->vruntime - fair_first ()->vruntime
+                  <= FAIR_WAKEUP_GRAN);
+  else
+    highest = cur->priority >= ready_max_priority ();
+  intr_set_level (old_level);
+
+  return highest;
+}
+
+/* Allocates an uninitialized struct child.  Returns a null pointer if
+   memory is not available. */
+struct child *
+thread_child_alloc (void)
+{
+  return slab_alloc (&child_cache);
+}
+
+/* Frees CHILD, which must have come from thread_child_alloc(). */
+void
+thread_child_free (struct child *child)
+{
+  slab_free (&child_cache, child);
 }
 
 /* Used to find the maximum of a list, by priority. */
@@ -1086,8 +1458,7 @@ thread_add_open_file (struct file *file)
       fd = last_file->fd + 1;
     }
 
-  struct open_file *new_open_file =
-      (struct open_file *) malloc (sizeof (struct open_file));
+  struct open_file *new_open_file = slab_alloc (&open_file_cache);
   if (new_open_file == NULL)
     return -1;
 
@@ -1132,11 +1503,9 @@ thread_close_open_file (int fd)
       struct open_file *of = list_entry (e, struct open_file, elem);
       if (of->fd == fd)
         {
-          filesys_lock_acquire ();
           file_close (of->file);
-          filesys_lock_release ();
           list_remove (e);
-          free (of);
+          slab_free (&open_file_cache, of);
           return;
         }
     }
@@ -1162,8 +1531,7 @@ thread_add_mapped_file (struct file *file, void *addr, int size)
       mapping_id = last_file->mapping_id + 1;
     }
 
-  struct mapped_file *new_mapped_file =
-      (struct mapped_file *) malloc (sizeof (struct mapped_file));
+  struct mapped_file *new_mapped_file = slab_alloc (&mapped_file_cache);
   if (new_mapped_file == NULL)
     return -1;
 
@@ -1192,7 +1560,7 @@ thread_remove_mapped_file (int mapping_id)
         {
           list_remove (e);
           page_write_to_mapped_file (mf->file, mf->addr, mf->size);
-          free (mf);
+          slab_free (&mapped_file_cache, mf);
           return;
         }
     }
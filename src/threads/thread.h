@@ -6,6 +6,8 @@
 #include <list.h>
 #include <stdint.h>
 #include "synch.h"
+#include "devices/timer.h"
+#include "threads/palloc.h"
 
 
 /* States in a thread's life cycle. */
@@ -96,16 +98,25 @@ struct thread
     int nice;                           /* Niceness. */
     int recent_cpu;                     /* Measure of how much CPU time
                                            a thread received recently. */
+    int64_t cpu_epoch;                  /* Number of once-per-second
+                                           recent_cpu decays applied. */
+    int weight;                         /* Load weight, from nice.  Used
+                                           by the fair scheduler. */
+    int64_t vruntime;                   /* Virtual runtime: CPU time
+                                           received, scaled down by
+                                           weight.  Used by the fair
+                                           scheduler. */
+    struct heap_elem fair_elem;         /* Element in run queue of the
+                                           fair scheduler. */
     struct list_elem allelem;           /* List element for all threads list. */
-    int64_t ticks_when_awake;           /* Timer ticks count when awakened. */
-    struct list_elem sleep_elem;        /* List element for sleeping list. */
+    struct timer_callout sleep_callout; /* Wakes the thread from a sleep. */
     struct semaphore sleep_sema;        /* Semaphore to make a thread sleep
                                            and wake it up. */
     struct lock *blocking_lock;         /* Lock causing the thread to block. */
-    struct list donated_priorities;     /* List of locks and donated priorities
-                                           for them. */
-    struct semaphore priority_sema;     /* Semaphore to control access to 
-                                           donated priorities */
+    struct heap_elem waiter_elem;       /* Element in blocking_lock's
+                                           waiters. */
+    struct heap held_locks;             /* Locks held, by priority donated
+                                           through them. */
 
 
     /* Shared between thread.c and synch.c. */
@@ -133,6 +144,10 @@ struct thread
                                            this process. */
     void * esp;                         /* Saved value for the stack pointer */
 
+    /* Owned by threads/palloc.c. */
+    struct page_magazine kernel_mag;    /* Cached free kernel pages. */
+    struct page_magazine user_mag;      /* Cached free user pages. */
+
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
@@ -184,6 +199,12 @@ struct mapped_file
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the fair-share scheduler, which shares the CPU in
+   proportion to weights derived from nice values and ignores
+   priorities.  Controlled by kernel command-line option
+   "-o fair". */
+extern bool thread_fair;
+
 void thread_init (void);
 void thread_start (void);
 
@@ -197,7 +218,6 @@ tid_t thread_create (const char *name, int priority, thread_func *, void *,
 void thread_block (void);
 void thread_unblock (struct thread *);
 void thread_sleep (int64_t ticks_when_awake);
-void thread_wake_up (void);
 
 struct thread *thread_current (void);
 tid_t thread_tid (void);
@@ -210,6 +230,8 @@ void thread_yield (void);
 typedef void thread_action_func (struct thread *t, void *aux);
 void thread_foreach (thread_action_func *, void *);
 
+void *thread_take_cached_pages (void);
+
 int thread_get_priority (void);
 void thread_choose_priority (struct thread *t);
 void thread_donate_priority (struct thread *t);
@@ -220,6 +242,9 @@ void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
+struct child *thread_child_alloc (void);
+void thread_child_free (struct child *);
+
 void yield_if_necessary (void);
 bool is_highest_priority (void);
 bool has_lower_priority (const struct list_elem *elem_1,
@@ -0,0 +1,201 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Deferred work.
+
+   Interrupt handlers must not sleep and should finish quickly,
+   and some work done in a thread's own context (writing back
+   buffers, say) does not need to hold that thread up.  Such work
+   can instead be described by a struct work and handed to
+   queue_work(), which may be called from any context, including
+   an interrupt handler.  A pool of kernel worker threads then
+   calls the work's function.
+
+   There is a queue for each work priority, with WORKERS_PER_QUEUE
+   workers of its own running at the thread priority given by
+   queue_thread_pri[], so that urgent work is not stuck behind a
+   long cleaning job, and background work does not compete with
+   user threads.  Within a queue, work runs in FIFO order.
+
+   A struct work is in at most one queue at a time: queuing work
+   that is already queued does nothing.  Once a worker dequeues
+   the work, it may be queued again, even by its own function.
+   The queues are protected by disabling interrupts. */
+
+/* Number of worker threads per queue. */
+#define WORKERS_PER_QUEUE 2
+
+/* A queue of work for one work priority. */
+struct work_queue
+  {
+    struct list works;          /* Queued struct works. */
+    struct semaphore avail;     /* Upped once per queued work. */
+  };
+
+static struct work_queue queues[WORK_PRI_CNT];
+
+/* Thread priority of each queue's workers. */
+static const int queue_thread_pri[WORK_PRI_CNT] =
+  {
+    PRI_MIN + 1,                /* WORK_PRI_LOW. */
+    PRI_DEFAULT,                /* WORK_PRI_NORMAL. */
+    PRI_DEFAULT + 16,           /* WORK_PRI_HIGH. */
+  };
+
+static thread_func worker;
+static timer_callout_func delayed_work_due;
+
+/* Initializes the work queues and starts their worker threads.
+   Must be called after thread_start(). */
+void
+workqueue_init (void)
+{
+  int pri, i;
+
+  for (pri = 0; pri < WORK_PRI_CNT; pri++)
+    {
+      struct work_queue *q = &queues[pri];
+
+      list_init (&q->works);
+      sema_init (&q->avail, 0);
+      for (i = 0; i < WORKERS_PER_QUEUE; i++)
+        {
+          char name[16];
+
+          snprintf (name, sizeof name, "worker/%d:%d", pri, i);
+          if (thread_create (name, queue_thread_pri[pri], worker, q,
+                             NULL) == TID_ERROR)
+            PANIC ("workqueue_init: can't start %s", name);
+        }
+    }
+}
+
+/* Initializes W to call FUNC in a worker thread of priority
+   PRIORITY, once queued. */
+void
+work_init (struct work *w, work_func *func, enum work_priority priority)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+  ASSERT (priority >= 0 && priority < WORK_PRI_CNT);
+
+  w->func = func;
+  w->priority = priority;
+  w->queued = false;
+  timer_callout_init (&w->timer, delayed_work_due, w);
+}
+
+/* Queues W to run in a worker thread.  Returns true if successful,
+   false if W was already queued.  May be called from an interrupt
+   handler. */
+bool
+queue_work (struct work *w)
+{
+  struct work_queue *q = &queues[w->priority];
+  enum intr_level old_level;
+  bool success = false;
+
+  old_level = intr_disable ();
+  if (!w->queued)
+    {
+      w->queued = true;
+      list_push_back (&q->works, &w->elem);
+      sema_up (&q->avail);
+      success = true;
+    }
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/* Queues W to run in a worker thread once TICKS timer ticks have
+   passed, or right away if TICKS <= 0.  Returns true if
+   successful, false if W was already queued or waiting for its
+   delay.  May be called from an interrupt handler. */
+bool
+queue_delayed_work (struct work *w, int64_t ticks)
+{
+  enum intr_level old_level;
+  bool success = false;
+
+  if (ticks <= 0)
+    return queue_work (w);
+
+  old_level = intr_disable ();
+  if (!w->queued && !w->timer.pending)
+    {
+      timer_callout_add (&w->timer, timer_ticks () + ticks);
+      success = true;
+    }
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/* Cancels W, if it is queued or waiting for its delay.  Returns
+   true if it was, false otherwise.  Does not wait for W's
+   function to return if a worker is already running it. */
+bool
+cancel_work (struct work *w)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  old_level = intr_disable ();
+  was_pending = timer_callout_cancel (&w->timer);
+  if (w->queued)
+    {
+      /* The queue's semaphore still counts W.  The worker that
+         wakes up for it will find nothing to do. */
+      list_remove (&w->elem);
+      w->queued = false;
+      was_pending = true;
+    }
+  intr_set_level (old_level);
+
+  return was_pending;
+}
+
+/* Returns true if W is queued or waiting for its delay. */
+bool
+work_pending (const struct work *w)
+{
+  return w->queued || w->timer.pending;
+}
+
+/* Worker thread.  Runs the work in work queue Q_, forever. */
+static void
+worker (void *q_)
+{
+  struct work_queue *q = q_;
+
+  for (;;)
+    {
+      struct work *w = NULL;
+      enum intr_level old_level;
+
+      sema_down (&q->avail);
+
+      old_level = intr_disable ();
+      if (!list_empty (&q->works))
+        {
+          w = list_entry (list_pop_front (&q->works), struct work, elem);
+          w->queued = false;
+        }
+      intr_set_level (old_level);
+
+      if (w != NULL)
+        w->func (w);
+    }
+}
+
+/* Timer callout for delayed work W_, which is now due. */
+static void
+delayed_work_due (void *w_)
+{
+  queue_work (w_);
+}
@@ -0,0 +1,44 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timer.h"
+
+/* Work priorities.  Each has its own queue, served by its own
+   worker threads at a matching thread priority. */
+enum work_priority
+  {
+    WORK_PRI_LOW,               /* Background work, e.g. cleaning. */
+    WORK_PRI_NORMAL,            /* Ordinary deferred work. */
+    WORK_PRI_HIGH,              /* Follow-up work from interrupts. */
+    WORK_PRI_CNT                /* Number of work priorities. */
+  };
+
+struct work;
+
+/* Function that carries out work W.  It runs in a worker
+   thread, so it may sleep. */
+typedef void work_func (struct work *w);
+
+/* A unit of deferred work, usually embedded in the structure
+   that the work is about. */
+struct work
+  {
+    struct list_elem elem;      /* Element in a work queue. */
+    work_func *func;            /* Function to call. */
+    enum work_priority priority; /* Queue to run in. */
+    bool queued;                /* True while in a work queue. */
+    struct timer_callout timer; /* Timer for delayed work. */
+  };
+
+void workqueue_init (void);
+
+void work_init (struct work *, work_func *, enum work_priority);
+bool queue_work (struct work *);
+bool queue_delayed_work (struct work *, int64_t ticks);
+bool cancel_work (struct work *);
+bool work_pending (const struct work *);
+
+#endif /* threads/workqueue.h */
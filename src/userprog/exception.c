@@ -183,7 +183,7 @@ page_fault (struct intr_frame *f)
           void *kernel_addr = palloc_get_page (PAL_USER | PAL_ZERO);
             
           /* Insert page into supplementary page table */
-          struct page *page = malloc (sizeof (struct page));
+          struct page *page = page_alloc ();
           page->uaddr = fault_addr;
           page->saddr = -1;
           page->write = true;
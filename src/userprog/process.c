@@ -57,7 +57,7 @@ process_execute (const char *args)
   char *file_name = strtok_r (args_file_name, " ", &save_ptr);
 
   /* Create a new thread to execute FILE_NAME. */
-  struct child *child = malloc (sizeof (struct child));
+  struct child *child = thread_child_alloc ();
   if (child == NULL) 
     {
       palloc_free_page (args_copy);
@@ -125,10 +125,8 @@ start_process (void *args_)
     }
 
   /* Deny writing to this program's executable file. */
-  filesys_lock_acquire ();
   struct file *executable = filesys_open (file_name);
   file_deny_write (executable);
-  filesys_lock_release ();
   thread_current ()->executable_file = executable;
 
   /* Set up array of pointers to ARGV elements. */
@@ -225,7 +223,7 @@ process_wait (tid_t child_tid)
           if (sema_try_down (&c->free_sema)) 
             {
               list_remove (e);
-              free (c);
+              thread_child_free (c);
             }
           else 
             sema_up (&c->free_sema);
@@ -369,9 +367,7 @@ load (const char *file_name, void (**eip) (void), void **esp)
   process_activate ();
 
   /* Open executable file. */
-  filesys_lock_acquire ();
   file = filesys_open (file_name);
-  filesys_lock_release ();
   if (file == NULL) 
     {
       printf ("load: %s: open failed\n", file_name);
@@ -543,7 +539,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-      struct page *page = malloc (sizeof (struct page));
+      struct page *page = page_alloc ();
       if (page == NULL)
         {
           //TODO - do something here?
@@ -584,7 +580,7 @@ setup_stack (void **esp)
       if (success)
        {
         /* Insert into supplementary page table */
-        struct page *page = malloc (sizeof (struct page));
+        struct page *page = page_alloc ();
         page->uaddr = ((uint8_t *) PHYS_BASE) - PGSIZE;
         page->saddr = -1;
         page->write = true;
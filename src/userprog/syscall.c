@@ -1,5 +1,6 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "devices/input.h"
 #include "devices/shutdown.h"
@@ -21,6 +22,8 @@ static void kill_process (void);
 static int *get_argument (int n, void *esp);
 static bool is_valid_buffer (char *buffer, int size);
 static int get_user (const uint8_t *uaddr);
+static int read_to_user (struct file *, char *buffer, int size);
+static int write_from_user (struct file *, const char *buffer, int size);
 
 static void h_halt     (struct intr_frame *f);
 static void h_exit     (struct intr_frame *f);
@@ -148,9 +151,7 @@ h_exec (struct intr_frame *f)
   char *cmd_line = (char *) *get_argument (1, f->esp);
 
   bool old_evictable = page_set_evictable (cmd_line, true);
-  filesys_lock_acquire ();
   tid_t tid = process_execute (cmd_line);
-  filesys_lock_release ();
   page_set_evictable (cmd_line, old_evictable);
   
 
@@ -212,9 +213,7 @@ h_create (struct intr_frame *f)
 
   /* Return TRUE if file gets created, FALSE otherwise. */
   bool old_evictable = page_set_evictable (file, true);
-  filesys_lock_acquire ();
   f->eax = filesys_create (file, initial_size);
-  filesys_lock_release ();
   page_set_evictable (file, old_evictable);
 }
 
@@ -232,9 +231,7 @@ h_remove (struct intr_frame *f)
 
   /* Return TRUE if file gets removed, FALSE otherwise. */
   bool old_evictable = page_set_evictable (file, true);
-  filesys_lock_acquire ();
   f->eax = filesys_remove (file);
-  filesys_lock_release ();
   page_set_evictable (file, old_evictable);
 }
 
@@ -252,9 +249,7 @@ h_open (struct intr_frame *f)
  
   /* Try opening the file. */
   bool old_evictable = page_set_evictable (file, true);
-  filesys_lock_acquire ();
   struct file *opened_file = filesys_open (file);
-  filesys_lock_release ();
   page_set_evictable (file, old_evictable);
 
   if (opened_file == NULL)
@@ -288,9 +283,7 @@ h_filesize (struct intr_frame *f)
 
   /* Get file size in bytes. */
   //bool old_evictable = page_set_evictable (file, true);
-  filesys_lock_acquire ();
   int size = file_length (file);
-  filesys_lock_release ();
   //page_set_evictable (file, old_evictable);
 
   f->eax = size;
@@ -337,11 +330,7 @@ h_read (struct intr_frame *f)
         }
 
       /* Try to read SIZE bytes from FILE to BUFFER. */
-      //bool old_evictable = page_set_evictable (file, true);
-      filesys_lock_acquire ();
-      int bytes_read = file_read (file, buffer, size);
-      filesys_lock_release ();
-      //page_set_evictable (file, old_evictable);
+      int bytes_read = read_to_user (file, buffer, size);
 
       /* Return how many bytes were actually read. */
       f->eax = bytes_read;
@@ -402,17 +391,79 @@ h_write (struct intr_frame *f)
         }
 
       /* Try to write SIZE bytes from BUFFER to FILE. */
-      //bool old_evictable = page_set_evictable (file, true);
-      filesys_lock_acquire ();  
-      int bytes_written = file_write (file, buffer, size);
-      filesys_lock_release ();  
-      //page_set_evictable (file, old_evictable);
+      int bytes_written = write_from_user (file, buffer, size);
 
       /* Return how many bytes were actually written. */
       f->eax = bytes_written;
     }
 }
 
+/* Reads up to SIZE bytes from FILE into user BUFFER, a page at a
+   time through a kernel bounce page, and returns the number of
+   bytes read.
+
+   The file system holds the inode and buffer cache locks while
+   it copies, so it must never touch user memory itself: a page
+   fault there, say on an unloaded page mapped from the same
+   file, would re-enter the file system and try to take a lock
+   this thread already holds.  Copying to BUFFER after
+   file_read() returns lets any fault be handled with no file
+   system locks held. */
+static int
+read_to_user (struct file *file, char *buffer, int size)
+{
+  uint8_t *bounce = palloc_get_page (0);
+  int bytes_read = 0;
+
+  if (bounce == NULL)
+    return -1;
+
+  while (bytes_read < size)
+    {
+      int left = size - bytes_read;
+      int chunk = left < PGSIZE ? left : PGSIZE;
+      int n = file_read (file, bounce, chunk);
+
+      memcpy (buffer + bytes_read, bounce, n);
+      bytes_read += n;
+      if (n < chunk)
+        break;
+    }
+
+  palloc_free_page (bounce);
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from user BUFFER to FILE, a page at a time
+   through a kernel bounce page, and returns the number of bytes
+   written.  See read_to_user() for why user memory is copied
+   outside the file system. */
+static int
+write_from_user (struct file *file, const char *buffer, int size)
+{
+  uint8_t *bounce = palloc_get_page (0);
+  int bytes_written = 0;
+
+  if (bounce == NULL)
+    return -1;
+
+  while (bytes_written < size)
+    {
+      int left = size - bytes_written;
+      int chunk = left < PGSIZE ? left : PGSIZE;
+      int n;
+
+      memcpy (bounce, buffer + bytes_written, chunk);
+      n = file_write (file, bounce, chunk);
+      bytes_written += n;
+      if (n < chunk)
+        break;
+    }
+
+  palloc_free_page (bounce);
+  return bytes_written;
+}
+
 /* The seek system call. */
 static void
 h_seek (struct intr_frame *f)
@@ -436,9 +487,7 @@ h_seek (struct intr_frame *f)
     }
 
   //bool old_evictable = page_set_evictable (file, true);
-  filesys_lock_acquire ();
   file_seek (file, position);
-  filesys_lock_release ();
   //page_set_evictable (file, old_evictable);
 }
 
@@ -458,9 +507,7 @@ h_tell (struct intr_frame *f)
     }
 
   bool old_evictable = page_set_evictable (file, true);
-  filesys_lock_acquire ();
   int position = file_tell (file);
-  filesys_lock_release ();
   page_set_evictable (file, old_evictable);
 
   /* Return the position of the next byte to be read or written. */
@@ -510,9 +557,7 @@ h_mmap (struct intr_frame *f)
  
   /* Get file size. */
   //bool old_evictable = page_set_evictable (open_file, true);
-  filesys_lock_acquire ();
   off_t file_size = file_length (open_file);
-  filesys_lock_release ();
   //page_set_evictable (open_file, old_evictable);
 
   if (file_size == 0)
@@ -554,15 +599,13 @@ h_mmap (struct intr_frame *f)
   
   /* Reopen the mapped file. */
   //old_evictable = page_set_evictable (open_file, true);
-  filesys_lock_acquire ();
   struct file *mapped_file = file_reopen (open_file);
-  filesys_lock_release ();
   //page_set_evictable (open_file, old_evictable);
 
   /* Add pages to the page table. */
   for (i = 0; i < file_size; i += PGSIZE)
     {
-      struct page *page = malloc (sizeof (struct page));
+      struct page *page = page_alloc ();
       if (page == NULL)
       {
         //TODO - do something here?
@@ -618,7 +661,7 @@ page_set_evictable (void *uaddr, bool new_evictable)
           void *kernel_addr = palloc_get_page (PAL_USER | PAL_ZERO);
             
           /* Insert page into supplementary page table */
-          struct page *page = malloc (sizeof (struct page));
+          struct page *page = page_alloc ();
           page->uaddr = uaddr;
           page->saddr = -1;
           page->write = true;
@@ -657,7 +700,7 @@ page_get_evictable (void *uaddr)
           void *kernel_addr = palloc_get_page (PAL_USER | PAL_ZERO);
  
           // Insert page into supplementary page table.
-          struct page *page = malloc (sizeof (struct page));
+          struct page *page = page_alloc ();
           page->uaddr = uaddr;
           page->saddr = -1;
           page->write = true;
@@ -1,19 +1,33 @@
 #include "vm/frame.h"
-#include <random.h>
 #include <debug.h>
 #include <stdio.h>
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/pagedir.h"
 #include "vm/page.h"
 
 static struct hash frame_table; /* Frame table*/
+static struct slab_cache frame_cache; /* Cache of frame table entries. */
+
+/* The frames in frame_table again, in a ring that the clock hand
+   sweeps to choose eviction victims.  CLOCK_HAND is the next
+   frame to consider, or the list tail if it has to wrap around. */
+static struct list frame_list;
+static struct list_elem *clock_hand;
+
+static void unlink_frame (struct frame *);
 
 void
 frame_init (void)
 {
   hash_init (&frame_table, &frame_hash_func, &frame_less_func, NULL);
+  list_init (&frame_list);
+  clock_hand = list_end (&frame_list);
+  slab_cache_init (&frame_cache, "frame", sizeof (struct frame),
+                   __alignof__ (struct frame), NULL);
 }
 
 struct frame *
@@ -30,13 +44,21 @@ frame_lookup (void *addr)
 void
 frame_insert (void *faddr, void *uaddr, bool write)
 {
-  struct frame *f = malloc (sizeof (struct frame));
+  struct frame *f = slab_alloc (&frame_cache);
   f->addr = faddr;
   f->uaddr = uaddr;
   f->write = write;
   f->owner = thread_current ();
+  f->evictable = true;
   
   hash_insert (&frame_table, &f->hash_elem);
+  list_push_back (&frame_list, &f->list_elem);
+}
+
+void
+frame_free (struct frame *f)
+{
+  slab_free (&frame_cache, f);
 }
 
 struct frame *
@@ -44,6 +66,7 @@ frame_remove (void *kpage)
 {
   struct frame *removing = frame_lookup (kpage);
   hash_delete (&frame_table, &removing->hash_elem);
+  unlink_frame (removing);
   return removing;
 }
 
@@ -54,7 +77,8 @@ frame_remove_by_upage (void *upage)
   if (f != NULL)
     {
       hash_delete (&frame_table, &f->hash_elem);
-      free (f);
+      unlink_frame (f);
+      frame_free (f);
     }
 }
 
@@ -77,26 +101,54 @@ frame_less_func (const struct hash_elem *a, const struct hash_elem *b,
 void
 frame_evict ()
 {
-  struct thread *t = thread_current ();
-  struct pool *user_pool = get_user_pool ();
-  struct frame *evictee;  
-  int frame_table_size = hash_size (&frame_table);
-  int index;
-  
-  do {
-    index = (random_ulong () % (frame_table_size - 1)) + 1;
-    void *i = user_pool->base + PGSIZE * index;
-    evictee = frame_lookup (i);
-  } while (evictee == NULL || !evictee->evictable);
+  size_t i, frame_cnt = list_size (&frame_list);
+
+  /* User pages are not packed at the start of the user pool, whose
+     pages may be lent to the kernel, so sweep the frames in use
+     rather than pool addresses.  A frame whose page was accessed
+     since the hand last passed gets a second chance.  The first
+     sweep clears every accessed bit on the way, so two sweeps
+     find any evictable frame. */
+  for (i = 0; i < 2 * frame_cnt; i++)
+    {
+      struct frame *f;
+
+      if (clock_hand == list_end (&frame_list))
+        clock_hand = list_begin (&frame_list);
+      f = list_entry (clock_hand, struct frame, list_elem);
+      clock_hand = list_next (clock_hand);
+
+      if (!f->evictable)
+        continue;
+      if (pagedir_is_accessed (f->owner->pagedir, f->uaddr))
+        {
+          pagedir_set_accessed (f->owner->pagedir, f->uaddr, false);
+          continue;
+        }
+
+      page_create (f);
+      return;
+    }
+
+  PANIC ("no evictable frame among %zu frames", frame_cnt);
+}
 
-  page_create (evictee);
+/* Removes F from the clock list, moving the clock hand past F
+   first if it points to F. */
+static void
+unlink_frame (struct frame *f)
+{
+  if (clock_hand == &f->list_elem)
+    clock_hand = list_next (clock_hand);
+  list_remove (&f->list_elem);
 }
 
 void
 frame_destroy (struct hash_elem *e, void *aux UNUSED)
 {
   struct frame *f = hash_entry (e, struct frame, hash_elem);
-  free (f);
+  unlink_frame (f);
+  frame_free (f);
 }
 
 void
@@ -2,6 +2,7 @@
 #define VM_FRAME_H
 
 #include <hash.h>
+#include <list.h>
 
 struct frame
   {
@@ -10,6 +11,7 @@ struct frame
     bool write;
     struct thread *owner;       /* Owner of the frame. */
     struct hash_elem hash_elem; /* Hash element in frame table. */
+    struct list_elem list_elem; /* Element in clock list. */
     bool evictable;             /* Used to implement pinning. */
   };
 
@@ -23,6 +25,9 @@ struct frame *frame_lookup (void *addr);
    into the table. */
 void frame_insert (void *faddr, void *uaddr, bool write);
 
+/* Frees a frame that is no longer in the frame table. */
+void frame_free (struct frame *);
+
 /* Removes and returns a frame from the frame table. */
 struct frame* frame_remove (void *);
 
@@ -36,7 +41,8 @@ unsigned frame_hash_func (const struct hash_elem *e, void *aux);
 bool frame_less_func (const struct hash_elem *a, const struct hash_elem *b,
                       void *aux);
 
-/* Evicts a frame randomly, creates a page and sends it to swap */
+/* Evicts a frame chosen by the clock algorithm, creates a page and
+   sends it to swap.  Panics if no frame can be evicted. */
 void frame_evict (void);
 
 /* Destructor for a frame. */
@@ -8,12 +8,15 @@
 #include "filesys/file.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/vaddr.h"
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
 #include "vm/frame.h"
 #include "vm/swap.h"
 
+/* Cache of supplemental page table entries. */
+static struct slab_cache page_cache;
 
 /* Loads a page from the file system into memory */
 void page_filesys_load (struct page *upage, void *kpage);
@@ -22,6 +25,25 @@ void page_filesys_load (struct page *upage, void *kpage);
    a memory-mapped file. */
 static bool page_load_from_mapped_file (struct page *upage, void *fault_addr);
 
+void
+page_init (void)
+{
+  slab_cache_init (&page_cache, "page", sizeof (struct page),
+                   __alignof__ (struct page), NULL);
+}
+
+struct page *
+page_alloc (void)
+{
+  return slab_alloc (&page_cache);
+}
+
+void
+page_free (struct page *page)
+{
+  slab_free (&page_cache, page);
+}
+
 bool
 page_load (struct page *upage, void *fault_addr)
 {
@@ -133,7 +155,7 @@ page_create (struct frame *frame)
     upage->saddr = swap_write_page (upage);
   uninstall_page (frame->addr);
   palloc_free_page (frame->addr);
-  free (frame);
+  frame_free (frame);
 }
 
 void
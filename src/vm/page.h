@@ -23,6 +23,16 @@ struct page
     struct hash_elem hash_elem; /* Hash elem. for a supplemental page table. */
   };
 
+/* Initializes the cache that struct pages are allocated from. */
+void page_init (void);
+
+/* Allocates an uninitialized struct page.  Returns NULL if memory is
+   not available. */
+struct page *page_alloc (void);
+
+/* Frees a struct page obtained from page_alloc(). */
+void page_free (struct page *);
+
 /* Called when there is a page fault to load the relevant page back into
    memory. */
 bool page_load (struct page *upage, void *fault_addr);